@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The BoundedQueue class is a fixed capacity lock-free queue for many producers
+ * and many consumers (sequence numbered cells, D. Vyukov's scheme). Producer is
+ * allowed to pop, that is how the oldest items are dropped on overflow
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+    /**
+     * Default constructor
+     * @param capacity - maximum number of items, rounded up to the power of two
+     */
+    explicit BoundedQueue(size_t capacity = 8) :
+        m_enqueue(0),
+        m_dequeue(0)
+    {
+        size_t size = 2;
+        while(size < capacity)
+            size <<= 1;
+        m_mask = size - 1;
+        v_cells = new Cell[size];
+        for(size_t i = 0; i < size; i++)
+            v_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    /**
+     * Class destructor
+     */
+    virtual ~BoundedQueue()
+    {
+        delete[] v_cells;
+    }
+    /**
+     * Append item
+     * @param item - self explained
+     * @return false if queue is full
+     */
+    bool push(const T &item)
+    {
+        Cell *cell;
+        size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        while(true) {
+            cell = &v_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if(diff == 0) {
+                if(m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if(diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    /**
+     * Append item, the oldest items are dropped if queue is full
+     * @param item - self explained
+     * @return number of dropped items
+     */
+    size_t pushDropOldest(const T &item)
+    {
+        size_t dropped = 0;
+        T oldest;
+        while(push(item) == false)
+            if(pop(oldest))
+                dropped++;
+        return dropped;
+    }
+    /**
+     * Take the oldest item
+     * @param item - where item should be written
+     * @return false if queue is empty
+     */
+    bool pop(T &item)
+    {
+        Cell *cell;
+        size_t pos = m_dequeue.load(std::memory_order_relaxed);
+        while(true) {
+            cell = &v_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if(diff == 0) {
+                if(m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if(diff < 0) {
+                return false;
+            } else {
+                pos = m_dequeue.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->data;
+        cell->data = T(); // do not hold resources (e.g. image data) of the taken item
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+    /**
+     * @brief approximate number of items, exact when queue is not used concurrently
+     * @return self explained
+     */
+    size_t size() const
+    {
+        size_t enqueue = m_enqueue.load(std::memory_order_relaxed);
+        size_t dequeue = m_dequeue.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+    /**
+     * @brief self explained
+     * @return maximum number of items
+     */
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    BoundedQueue(const BoundedQueue &);
+    BoundedQueue &operator=(const BoundedQueue &);
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    Cell *v_cells;
+    size_t m_mask;
+    char m_pad0[64];
+    std::atomic<size_t> m_enqueue;
+    char m_pad1[64];
+    std::atomic<size_t> m_dequeue;
+    char m_pad2[64];
+};
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
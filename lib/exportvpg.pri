@@ -1,4 +1,4 @@
-VPGLIBPATH = C:/Programming/vpglib
+VPGLIBPATH = $$clean_path($${PWD}/..)
 
 defineReplace(qtLibraryName) {
    unset(LIBRARY_NAME)
@@ -13,14 +13,21 @@ win32-msvc2012: COMPILER = vc11
 win32-msvc2013: COMPILER = vc12
 win32-msvc2015: COMPILER = vc14
 win32-g++:      COMPILER = mingw
+unix:           COMPILER = $$basename(QMAKE_CXX)
 win32:contains(QMAKE_TARGET.arch, x86_64){
     ARCHITECTURE = x64
+} else:unix {
+    ARCHITECTURE = $${QMAKE_HOST.arch}
 } else {
     ARCHITECTURE = x86
 }
 
 LIBS += -L$${VPGLIBPATH}/lib/build/$${ARCHITECTURE}/$${COMPILER}
 LIBS += -l$$qtLibraryName(vpg)
+unix {
+    QMAKE_RPATHDIR += $${VPGLIBPATH}/lib/build/$${ARCHITECTURE}/$${COMPILER}
+    LIBS += -pthread
+}
 
 
 INCLUDEPATH += $${VPGLIBPATH}/lib
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#include "facedetectormodel.h"
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+
+namespace vpg {
+
+namespace {
+// last model used by the thread and its classifier, so steady state detection does not lock the model
+struct ThreadCache {
+    unsigned long id;
+    cv::CascadeClassifier *classifier;
+};
+thread_local ThreadCache t_cache = {0, 0};
+std::atomic<unsigned long> g_id(0);
+}
+
+FaceDetectorModel::FaceDetectorModel(const std::string &filename, unsigned int threads) :
+    m_filename(filename),
+    f_loaded(false),
+    m_id(++g_id)
+{
+    threads = std::max(threads, 1u);
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if(!file.is_open())
+        return;
+    std::string content;
+    {
+        std::ostringstream stream;
+        stream << file.rdbuf();
+        content = stream.str();
+    }
+    // file is parsed once, the parsed storage is kept, so classifiers of the extra threads are built without reading the file again
+    if(m_storage.open(content, cv::FileStorage::READ | cv::FileStorage::MEMORY)) {
+        m_node = m_storage.getFirstTopLevelNode();
+        for(unsigned int i = 0; i < threads; i++) {
+            cv::CascadeClassifier *classifier = new cv::CascadeClassifier();
+            if(!classifier->read(m_node)) {
+                delete classifier;
+                break;
+            }
+            v_classifiers.push_back(classifier);
+        }
+    }
+    if(v_classifiers.empty()) {
+        // old format cascades could not be read from the node, they are loaded from the file
+        m_node = cv::FileNode();
+        m_storage.release();
+        cv::CascadeClassifier *classifier = new cv::CascadeClassifier();
+        if(classifier->load(m_filename) == false) {
+            delete classifier;
+            return;
+        }
+        v_classifiers.push_back(classifier);
+    }
+    v_free = v_classifiers;
+    f_loaded = true;
+}
+
+FaceDetectorModel::~FaceDetectorModel()
+{
+    for(size_t i = 0; i < v_classifiers.size(); i++)
+        delete v_classifiers[i];
+}
+
+bool FaceDetectorModel::empty() const
+{
+    return !f_loaded;
+}
+
+cv::CascadeClassifier &FaceDetectorModel::getThreadClassifier() const
+{
+    if(t_cache.id != m_id) {
+        t_cache.classifier = __assign();
+        t_cache.id = m_id;
+    }
+    return *t_cache.classifier;
+}
+
+cv::CascadeClassifier *FaceDetectorModel::__assign() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    cv::CascadeClassifier *&classifier = m_assigned[std::this_thread::get_id()];
+    if(classifier == 0) {
+        if(!v_free.empty()) {
+            classifier = v_free.back();
+            v_free.pop_back();
+        } else {
+            classifier = new cv::CascadeClassifier();
+            if(f_loaded && !(m_storage.isOpened() && classifier->read(m_node)))
+                classifier->load(m_filename); // old format cascade
+            v_classifiers.push_back(classifier);
+        }
+    }
+    return classifier;
+}
+
+void FaceDetectorModel::releaseThreadClassifier() const
+{
+    if(t_cache.id == m_id)
+        t_cache.id = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<std::thread::id, cv::CascadeClassifier *>::iterator it = m_assigned.find(std::this_thread::get_id());
+    if(it != m_assigned.end()) {
+        v_free.push_back(it->second);
+        m_assigned.erase(it);
+    }
+}
+
+size_t FaceDetectorModel::getThreadsCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_assigned.size();
+}
+
+size_t FaceDetectorModel::getClassifiersCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return v_classifiers.size();
+}
+
+} // end of namespace vpg
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef FACEDETECTORMODEL_H
+#define FACEDETECTORMODEL_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+
+#include "vpg.h"
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The FaceDetectorModel class reads and parses cascade file once and shares it
+ * between many FaceProcessor instances and threads. cv::CascadeClassifier keeps
+ * scratch buffers, so each thread that runs detection gets its own classifier,
+ * memory scales with the number of threads, not with the number of FaceProcessors.
+ * Classifiers for the expected number of threads are built from the parsed file
+ * in the constructor, the parsed file is kept, so classifiers for the extra threads
+ * are built without reading the file again. Model is immutable after construction
+ */
+class DLLSPEC FaceDetectorModel
+{
+public:
+    /**
+     * Class constructor
+     * @param filename - name of file for cv::CascadeClassifier class
+     * @param threads - expected number of threads that will run detection
+     */
+    FaceDetectorModel(const std::string &filename, unsigned int threads = 1);
+    /**
+     * Class destructor, deletes classifiers of all threads
+     * @note should not be called while other threads use the model
+     */
+    virtual ~FaceDetectorModel();
+    /**
+     * @brief check if model has been loaded
+     * @return self explained
+     */
+    bool empty() const;
+    /**
+     * Get classifier of the calling thread, the classifier is assigned on the first call from each thread,
+     * next calls from the same thread do not lock
+     * @return classifier that should be used only by the calling thread
+     */
+    cv::CascadeClassifier &getThreadClassifier() const;
+    /**
+     * Return classifier of the calling thread to the model, so it could be assigned to other thread,
+     * call it before the worker thread exits, otherwise the classifier stays assigned to the dead thread
+     */
+    void releaseThreadClassifier() const;
+    /**
+     * @brief self explained
+     * @return number of threads that own the classifier
+     */
+    size_t getThreadsCount() const;
+    /**
+     * @brief self explained
+     * @return number of classifiers that were built, it is equal to the max number of threads that used the model at once
+     */
+    size_t getClassifiersCount() const;
+
+private:
+    FaceDetectorModel(const FaceDetectorModel &);
+    FaceDetectorModel &operator=(const FaceDetectorModel &);
+
+    cv::CascadeClassifier *__assign() const;
+
+    std::string m_filename;
+    cv::FileStorage m_storage; // parsed file, guarded by m_mutex after construction
+    cv::FileNode m_node;
+    bool f_loaded;
+    unsigned long m_id; // unique for each instance, identifies the model in the thread caches
+    mutable std::mutex m_mutex;
+    mutable std::vector<cv::CascadeClassifier *> v_classifiers;
+    mutable std::vector<cv::CascadeClassifier *> v_free;
+    mutable std::map<std::thread::id, cv::CascadeClassifier *> m_assigned;
+};
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <vector>
+#include <mutex>
+#include <functional>
+
+#include "vpg.h"
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The ObjectPool class keeps released PulseProcessor or FaceProcessor instances
+ * for the reuse, so session churn does not pay for allocations and classifier loading
+ * @note T should have reset() method, pool is thread safe
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+    /**
+     * Default constructor
+     * @param factory - creates new instance when there are no idle ones, e.g. [](){ return new vpg::FaceProcessor(filename); }
+     * @param reserve - number of instances to create beforehand
+     */
+    ObjectPool(const std::function<T*()> &factory, size_t reserve = 0) :
+        m_factory(factory)
+    {
+        for(size_t i = 0; i < reserve; i++)
+            v_idle.push_back(m_factory());
+    }
+    /**
+     * Class destructor, deletes idle instances
+     * @note instances that were not released should be deleted by the owner
+     */
+    virtual ~ObjectPool()
+    {
+        for(size_t i = 0; i < v_idle.size(); i++)
+            delete v_idle[i];
+    }
+    /**
+     * Take instance from the pool
+     * @return idle instance or new one created by factory
+     */
+    T *acquire()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(!v_idle.empty()) {
+                T *object = v_idle.back();
+                v_idle.pop_back();
+                return object;
+            }
+        }
+        return m_factory();
+    }
+    /**
+     * Return instance to the pool, reset() is called for it
+     * @param object - instance taken by acquire()
+     */
+    void release(T *object)
+    {
+        object->reset();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        v_idle.push_back(object);
+    }
+    /**
+     * @brief self explained
+     * @return number of idle instances
+     */
+    size_t getIdle() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return v_idle.size();
+    }
+
+private:
+    ObjectPool(const ObjectPool &);
+    ObjectPool &operator=(const ObjectPool &);
+
+    std::function<T*()> m_factory;
+    std::vector<T*> v_idle;
+    mutable std::mutex m_mutex;
+};
+
+typedef ObjectPool<PulseProcessor> PulseProcessorPool;
+typedef ObjectPool<FaceProcessor> FaceProcessorPool;
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
@@ -1,23 +1,4 @@
 #--------------------------------------------------------OPENCV----------------------------------------------------
-#Specify a path to the build directory of opencv library and library version
-OPENCV_VERSION = 310
-OPENCV_DIR = C:/Programming/3rdParties/opencv$${OPENCV_VERSION}/build
-INCLUDEPATH += $${OPENCV_DIR}/include
-
-#Specify the part of OpenCV path corresponding to compiler version
-win32-msvc2010: OPENCV_COMPILER = vc10
-win32-msvc2012: OPENCV_COMPILER = vc11
-win32-msvc2013: OPENCV_COMPILER = vc12
-win32-msvc2015: OPENCV_COMPILER = vc14
-win32-g++:      OPENCV_COMPILER = mingw
-
-#Specify the part of OpenCV path corresponding to target architecture
-win32:contains(QMAKE_TARGET.arch, x86_64){
-    OPENCV_ARCHITECTURE = x64
-} else {
-    OPENCV_ARCHITECTURE = x86
-}
-
 #A tricky way to resolve debug and release library versions
 defineReplace(qtLibraryName) {
    unset(LIBRARY_NAME)
@@ -27,18 +8,56 @@ defineReplace(qtLibraryName) {
    return($$RET)
 }
 
-#Specify path to *.lib files
-win32-msvc*:LIBS += -L$${OPENCV_DIR}/$${OPENCV_ARCHITECTURE}/$${OPENCV_COMPILER}/lib/
-win32-msvc*:LIBS += -L$${OPENCV_DIR}/$${OPENCV_ARCHITECTURE}/$${OPENCV_COMPILER}/bin/
-win32-g++:  LIBS += -L$${OPENCV_DIR}/$${OPENCV_ARCHITECTURE}/$${OPENCV_COMPILER}/bin/
+win32 {
+    #Specify a path to the build directory of opencv library and library version
+    OPENCV_VERSION = 310
+    OPENCV_DIR = C:/Programming/3rdParties/opencv$${OPENCV_VERSION}/build
+    INCLUDEPATH += $${OPENCV_DIR}/include
+
+    #Specify the part of OpenCV path corresponding to compiler version
+    win32-msvc2010: OPENCV_COMPILER = vc10
+    win32-msvc2012: OPENCV_COMPILER = vc11
+    win32-msvc2013: OPENCV_COMPILER = vc12
+    win32-msvc2015: OPENCV_COMPILER = vc14
+    win32-g++:      OPENCV_COMPILER = mingw
+
+    #Specify the part of OpenCV path corresponding to target architecture
+    contains(QMAKE_TARGET.arch, x86_64){
+        OPENCV_ARCHITECTURE = x64
+    } else {
+        OPENCV_ARCHITECTURE = x86
+    }
+
+    #Specify path to *.lib files
+    win32-msvc*:LIBS += -L$${OPENCV_DIR}/$${OPENCV_ARCHITECTURE}/$${OPENCV_COMPILER}/lib/
+    win32-msvc*:LIBS += -L$${OPENCV_DIR}/$${OPENCV_ARCHITECTURE}/$${OPENCV_COMPILER}/bin/
+    win32-g++:  LIBS += -L$${OPENCV_DIR}/$${OPENCV_ARCHITECTURE}/$${OPENCV_COMPILER}/bin/
+
+    #Specify names of *.lib files
+    LIBS += -l$$qtLibraryName(opencv_core$${OPENCV_VERSION}) \
+            -l$$qtLibraryName(opencv_highgui$${OPENCV_VERSION}) \
+            -l$$qtLibraryName(opencv_imgproc$${OPENCV_VERSION}) \
+            -l$$qtLibraryName(opencv_objdetect$${OPENCV_VERSION}) \
+            -l$$qtLibraryName(opencv_videoio$${OPENCV_VERSION})
 
-#Specify names of *.lib files
-LIBS += -l$$qtLibraryName(opencv_core$${OPENCV_VERSION}) \
-        -l$$qtLibraryName(opencv_highgui$${OPENCV_VERSION}) \
-        -l$$qtLibraryName(opencv_imgproc$${OPENCV_VERSION}) \
-        -l$$qtLibraryName(opencv_objdetect$${OPENCV_VERSION}) \
-        -l$$qtLibraryName(opencv_videoio$${OPENCV_VERSION})
+    OPENCV_DATA_DIR = $${OPENCV_DIR}/../sources/data
 
-DEFINES += OPENCV_DATA_DIR=\\\"$${OPENCV_DIR}/../sources/data\\\"
+    message(OpenCV library version $${OPENCV_DIR}/$${OPENCV_ARCHITECTURE}/$${OPENCV_COMPILER} will be used)
+}
+
+unix {
+    #System OpenCV is located by pkg-config, run qmake OPENCV_PKG=<name> to select other package
+    isEmpty(OPENCV_PKG) {
+        OPENCV_PKG = opencv
+        packagesExist(opencv4): OPENCV_PKG = opencv4
+    }
+    CONFIG += link_pkgconfig
+    PKGCONFIG += $${OPENCV_PKG}
+
+    #Cascades are installed to <prefix>/share/<package>, run qmake OPENCV_DATA_DIR=<path> if it is not so
+    isEmpty(OPENCV_DATA_DIR): OPENCV_DATA_DIR = $$system(pkg-config --variable=prefix $${OPENCV_PKG})/share/$${OPENCV_PKG}
+
+    message(OpenCV library $${OPENCV_PKG} $$system(pkg-config --modversion $${OPENCV_PKG}) will be used)
+}
 
-message(OpenCV library version $${OPENCV_DIR}/$${OPENCV_ARCHITECTURE_DIR}/$${OPENCV_COMPILER_DIR} will be used)
+DEFINES += OPENCV_DATA_DIR=\\\"$${OPENCV_DATA_DIR}\\\"
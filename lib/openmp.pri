@@ -4,7 +4,7 @@ openmp {
     win32-msvc* {
         QMAKE_CXXFLAGS+= -openmp
     }
-    win32-g++ {
+    win32-g++|unix {
         QMAKE_CXXFLAGS+= -fopenmp
         LIBS += -fopenmp
     }
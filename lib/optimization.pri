@@ -0,0 +1,39 @@
+#-----------------------------------------------OPTIMIZATION-------------------------------------------------------
+#Link time optimization: qmake CONFIG+=ltcg
+#Profile guided optimization is made in two builds of the library and test_Bench:
+#   1) qmake CONFIG+=pgo_generate, build, then run test_Bench (synthetic signal and synthetic frames for the ROI stage,
+#      add -i<video> to profile the face detection also)
+#   2) qmake CONFIG+=pgo_use, rebuild, the profile collected at the step 1 will be used
+#The profile is stored in PGO_DIR, run qmake PGO_DIR=<path> to select other location
+
+isEmpty(PGO_DIR): PGO_DIR = $$clean_path($${PWD}/build/pgo)
+
+pgo_generate:pgo_use: error(pgo_generate and pgo_use can not be used together)
+
+pgo_generate {
+    message(Instrumented build, profile will be written to $${PGO_DIR})
+    unix|win32-g++ {
+        QMAKE_CXXFLAGS += -fprofile-generate=$${PGO_DIR} -fprofile-update=atomic
+        QMAKE_LFLAGS += -fprofile-generate=$${PGO_DIR}
+    }
+    win32-msvc* {
+        QMAKE_CXXFLAGS += -GL
+        QMAKE_LFLAGS += /LTCG:PGINSTRUMENT /PGD:$$shell_path($${PGO_DIR}/vpg.pgd)
+    }
+}
+
+pgo_use {
+    message(Profile guided build, profile will be read from $${PGO_DIR})
+    unix|win32-g++ {
+        # -fprofile-correction is needed for the counters collected by several threads
+        QMAKE_CXXFLAGS += -fprofile-use=$${PGO_DIR} -fprofile-correction
+        QMAKE_LFLAGS += -fprofile-use=$${PGO_DIR}
+        # code that the training run does not reach (e.g. RoiAccumulator, Pipeline) is optimized as usual instead of
+        # being treated as cold, it costs some code size
+        greaterThan(QMAKE_GCC_MAJOR_VERSION, 9): QMAKE_CXXFLAGS += -fprofile-partial-training
+    }
+    win32-msvc* {
+        QMAKE_CXXFLAGS += -GL
+        QMAKE_LFLAGS += /LTCG:PGOPTIMIZE /PGD:$$shell_path($${PGO_DIR}/vpg.pgd)
+    }
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#include "parametersweep.h"
+
+#include <thread>
+#include <atomic>
+
+namespace vpg {
+
+ParameterSweep::ParameterSweep(double measInterval_ms, double referenceHR) :
+    m_measInterval(measInterval_ms),
+    m_referenceHR(referenceHR)
+{}
+
+void ParameterSweep::addParameters(const Parameters &parameters)
+{
+    v_parameters.push_back(parameters);
+}
+
+void ParameterSweep::addGrid(const std::vector<double> &Tov_ms, const std::vector<double> &Tcn_ms, const std::vector<double> &Tlpf_ms,
+                             const std::vector<double> &bottomFrequency, const std::vector<double> &topFrequency)
+{
+    Parameters p;
+    for(size_t a = 0; a < Tov_ms.size(); a++)
+        for(size_t b = 0; b < Tcn_ms.size(); b++)
+            for(size_t c = 0; c < Tlpf_ms.size(); c++)
+                for(size_t d = 0; d < bottomFrequency.size(); d++)
+                    for(size_t e = 0; e < topFrequency.size(); e++) {
+                        p.Tov_ms = Tov_ms[a];
+                        p.Tcn_ms = Tcn_ms[b];
+                        p.Tlpf_ms = Tlpf_ms[c];
+                        p.bottomFrequency = bottomFrequency[d];
+                        p.topFrequency = topFrequency[e];
+                        v_parameters.push_back(p);
+                    }
+}
+
+const std::vector<ParameterSweep::Parameters> &ParameterSweep::getParameters() const
+{
+    return v_parameters;
+}
+
+std::vector<ParameterSweep::Result> ParameterSweep::run(const SignalRecorder::Record *records, size_t count, unsigned int threads) const
+{
+    std::vector<Result> results(v_parameters.size());
+    double dT_ms = SignalReplay::getFramePeriod(records, count);
+    if(dT_ms <= 0.0 || v_parameters.empty())
+        return std::vector<Result>();
+
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned int>(threads, static_cast<unsigned int>(v_parameters.size()));
+
+    // configurations are taken one by one, so long and short windows are balanced between workers
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for(unsigned int t = 0; t < threads; t++)
+        workers.push_back(std::thread([&]() {
+            size_t i;
+            while((i = next.fetch_add(1)) < v_parameters.size())
+                results[i] = __evaluate(v_parameters[i], records, count, dT_ms);
+        }));
+    for(size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    return results;
+}
+
+bool ParameterSweep::__isValid(const Parameters &parameters, double dT_ms)
+{
+    // PulseProcessor windows are whole numbers of counts, each of them should hold at least one count,
+    // centering window needs two, with one count the standard deviation is NaN and the signal stays NaN
+    return parameters.Tov_ms >= dT_ms && parameters.Tcn_ms >= 2.0 * dT_ms && parameters.Tlpf_ms >= dT_ms
+           && parameters.bottomFrequency >= 0.0 && parameters.topFrequency > parameters.bottomFrequency;
+}
+
+ParameterSweep::Result ParameterSweep::__evaluate(const Parameters &parameters, const SignalRecorder::Record *records, size_t count, double dT_ms) const
+{
+    Result result;
+    result.parameters = parameters;
+    result.valid = __isValid(parameters, dT_ms);
+    result.measurements = 0;
+    result.meanHR = 0.0;
+    result.stdHR = 0.0;
+    result.meanSNR = 0.0;
+    result.meanError = -1.0; // stays so without measurements, a dead configuration should not look like a perfect one
+    result.hitRate = -1.0;
+    result.firstResult_ms = -1.0;
+    result.cost_us = 0.0;
+    if(!result.valid)
+        return result;
+
+    double error = 0.0, hits = 0.0;
+    std::vector<double> hr, snr;
+    std::vector<bool> fresh;
+    hr.reserve(static_cast<size_t>(records[count - 1].time / m_measInterval) + 1);
+    snr.reserve(hr.capacity());
+    fresh.reserve(hr.capacity());
+
+    int64 ticks = cv::getTickCount();
+    PulseProcessor proc(parameters.Tov_ms, parameters.Tcn_ms, parameters.Tlpf_ms, dT_ms, PulseProcessor::HeartRate);
+    proc.setFrequencyLimits(parameters.bottomFrequency, parameters.topFrequency);
+    SignalReplay::replay(records, count, proc, m_measInterval, &hr, &snr, &fresh);
+    result.cost_us = (cv::getTickCount() - ticks) * 1.0e6 / (cv::getTickFrequency() * count);
+
+    for(size_t i = 0; i < hr.size(); i++) {
+        if(fresh[i]) { // processor repeats the previous result when snr is below the threshold, it is not a measurement
+            if(result.measurements == 0)
+                result.firstResult_ms = (i + 1) * m_measInterval;
+            result.measurements++;
+            result.meanHR += hr[i];
+            result.stdHR += hr[i] * hr[i];
+            result.meanSNR += snr[i];
+            if(m_referenceHR > 0.0) {
+                double deviation = std::abs(hr[i] - m_referenceHR);
+                error += deviation;
+                if(deviation <= 5.0)
+                    hits += 1.0;
+            }
+        }
+    }
+    if(result.measurements > 0) {
+        double n = static_cast<double>(result.measurements);
+        result.meanHR /= n;
+        result.stdHR = std::sqrt(std::max(0.0, result.stdHR / n - result.meanHR * result.meanHR));
+        result.meanSNR /= n;
+        if(m_referenceHR > 0.0) {
+            result.meanError = error / n;
+            result.hitRate = hits / n;
+        }
+    }
+    return result;
+}
+
+} // end of namespace vpg
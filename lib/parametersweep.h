@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+#include "signalreplay.h"
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The ParameterSweep class evaluates many PulseProcessor configurations on one
+ * recorded signal, configurations are distributed across the cores and all of them
+ * read the same records buffer
+ */
+class DLLSPEC ParameterSweep
+{
+public:
+    /**
+     * PulseProcessor configuration, see overloaded PulseProcessor constructor
+     */
+    struct Parameters {
+        double Tov_ms;
+        double Tcn_ms;
+        double Tlpf_ms;
+        double bottomFrequency; // Hz
+        double topFrequency;    // Hz
+    };
+    /**
+     * Evaluation of one configuration
+     */
+    struct Result {
+        Parameters parameters;
+        bool valid;           // false if a window is shorter than the record frame period (centering one than two periods) or the band is empty, it is not evaluated then
+        size_t measurements;  // number of HR measurements with snr above the processor threshold
+        double meanHR;        // bpm
+        double stdHR;         // bpm
+        double meanSNR;       // dB
+        double meanError;     // mean absolute error against reference HR in bpm, -1.0 if reference is not set or there were no measurements
+        double hitRate;       // part of valid measurements within 5 bpm of the reference, -1.0 if reference is not set or there were no measurements
+        double firstResult_ms; // record time to the first valid measurement, -1.0 if there was no one
+        double cost_us;       // processing time per record in microseconds
+    };
+    /**
+     * Default constructor
+     * @param measInterval_ms - heart rate is computed each time this interval of record time elapses
+     * @param referenceHR - true heart rate of the record in bpm, use non positive value if it is unknown
+     */
+    ParameterSweep(double measInterval_ms = 1000.0, double referenceHR = -1.0);
+    /**
+     * Append one configuration
+     * @param parameters - configuration to evaluate
+     */
+    void addParameters(const Parameters &parameters);
+    /**
+     * Append all combinations of the given values
+     */
+    void addGrid(const std::vector<double> &Tov_ms, const std::vector<double> &Tcn_ms, const std::vector<double> &Tlpf_ms,
+                 const std::vector<double> &bottomFrequency, const std::vector<double> &topFrequency);
+    /**
+     * @brief self explained
+     * @return configurations that will be evaluated
+     */
+    const std::vector<Parameters> &getParameters() const;
+    /**
+     * Evaluate all configurations
+     * @param records - pointer to the first record (see SignalRecorder and SignalReplay)
+     * @param count - number of records
+     * @param threads - number of worker threads, 0 means number of hardware threads
+     * @return results in the order of configurations
+     */
+    std::vector<Result> run(const SignalRecorder::Record *records, size_t count, unsigned int threads = 0) const;
+
+private:
+    static bool __isValid(const Parameters &parameters, double dT_ms);
+    Result __evaluate(const Parameters &parameters, const SignalRecorder::Record *records, size_t count, double dT_ms) const;
+
+    std::vector<Parameters> v_parameters;
+    double m_measInterval;
+    double m_referenceHR;
+};
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#include "pipeline.h"
+
+#include <chrono>
+
+namespace vpg {
+
+Pipeline::Pipeline(cv::VideoCapture *capture, FaceProcessor *faceproc, PulseProcessor *pulseproc,
+                   OverflowPolicy policy, size_t queueCapacity) :
+    p_capture(capture),
+    p_faceproc(faceproc),
+    p_pulseproc(pulseproc),
+    m_policy(policy),
+    m_measInterval(1000.0),
+    m_frames(queueCapacity),
+    m_results(queueCapacity),
+    f_stop(true),
+    f_captureDone(true),
+    f_processDone(true),
+    f_sinkDone(true),
+    m_startTick(0),
+    f_filesource(false),
+    m_filePeriod(0.0)
+{
+    for(int i = 0; i < 4; i++) {
+        v_counters[i].processed.store(0);
+        v_counters[i].dropped.store(0);
+        v_counters[i].busy.store(0);
+    }
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+}
+
+void Pipeline::setSink(const std::function<void(const Result &)> &sink)
+{
+    m_sink = sink;
+}
+
+void Pipeline::setMeasureInterval(double measInterval_ms)
+{
+    m_measInterval = measInterval_ms;
+}
+
+bool Pipeline::start()
+{
+    if(isRunning() || !p_capture->isOpened())
+        return false;
+    __join();
+
+    for(int i = 0; i < 4; i++) {
+        v_counters[i].processed.store(0);
+        v_counters[i].dropped.store(0);
+        v_counters[i].busy.store(0);
+    }
+    f_stop.store(false);
+    f_captureDone.store(false);
+    f_processDone.store(false);
+    f_sinkDone.store(false);
+    m_startTick = cv::getTickCount();
+    p_faceproc->dropTimer();
+    // video files are decoded at any speed, so their frames are timed by the video, not by the clock
+    f_filesource = p_capture->get(cv::CAP_PROP_POS_MSEC) != -1;
+    m_filePeriod = 1000.0 / p_capture->get(cv::CAP_PROP_FPS);
+    if(!(m_filePeriod > 0.0 && m_filePeriod < 1000.0))
+        m_filePeriod = 33.0;
+
+    v_threads[Capture] = std::thread(&Pipeline::__captureLoop, this);
+    v_threads[Process] = std::thread(&Pipeline::__processLoop, this);
+    v_threads[Estimate] = std::thread(&Pipeline::__estimateLoop, this);
+    v_threads[Sink] = std::thread(&Pipeline::__sinkLoop, this);
+    return true;
+}
+
+void Pipeline::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        f_stop.store(true);
+    }
+    m_condition.notify_all();
+    __join();
+
+    Frame frame;
+    while(m_frames.pop(frame));
+    Result result;
+    while(m_results.pop(result));
+}
+
+void Pipeline::wait()
+{
+    while(isRunning())
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    stop();
+}
+
+bool Pipeline::isRunning() const
+{
+    return !f_stop.load() && !f_sinkDone.load();
+}
+
+Pipeline::Metrics Pipeline::getMetrics(Stage stage) const
+{
+    Metrics metrics;
+    metrics.processed = v_counters[stage].processed.load();
+    metrics.dropped = v_counters[stage].dropped.load();
+    metrics.busy_ms = metrics.processed > 0 ? v_counters[stage].busy.load() * 1000.0 / (cv::getTickFrequency() * metrics.processed) : 0.0;
+    switch(stage) {
+        case Process:
+            metrics.queued = m_frames.size();
+            break;
+        case Sink:
+            metrics.queued = m_results.size();
+            break;
+        default:
+            metrics.queued = 0;
+            break;
+    }
+    return metrics;
+}
+
+void Pipeline::__join()
+{
+    for(int i = 0; i < 4; i++)
+        if(v_threads[i].joinable())
+            v_threads[i].join();
+}
+
+void Pipeline::__backoff(int &idle)
+{
+    // queues do not block, so empty or full queue is polled with growing pauses
+    if(++idle < 64)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+}
+
+void Pipeline::__captureLoop()
+{
+    Counters &counters = v_counters[Capture];
+    Frame frame;
+    frame.index = 0;
+    double position = -1.0;
+    while(!f_stop.load()) {
+        int64 tick = cv::getTickCount();
+        if(!p_capture->read(frame.image))
+            break;
+        int64 captured = cv::getTickCount();
+        if(f_filesource) {
+            // position of the decoded frame start, some backends do not report it, frame rate is used then
+            double start = p_capture->get(cv::CAP_PROP_POS_MSEC);
+            if(!(start > position))
+                start = frame.index * m_filePeriod;
+            position = start;
+            frame.time = start + m_filePeriod;
+        } else {
+            frame.time = (captured - m_startTick) * 1000.0 / cv::getTickFrequency();
+        }
+        if(m_policy == DropOldest) {
+            v_counters[Process].dropped.fetch_add(m_frames.pushDropOldest(frame));
+        } else {
+            int idle = 0;
+            while(!m_frames.push(frame) && !f_stop.load())
+                __backoff(idle);
+        }
+        frame.image = cv::Mat(); // capture should not write into the queued frame
+        frame.index++;
+        counters.processed.fetch_add(1);
+        counters.busy.fetch_add(captured - tick);
+    }
+    f_captureDone.store(true);
+}
+
+void Pipeline::__processLoop()
+{
+    Counters &counters = v_counters[Process];
+    Frame frame;
+    Result result;
+    double prevtime = 0.0, prevvalue = 0.0, period = 0.0, proctime = 0.0;
+    uint64 previndex = 0;
+    bool first = true;
+    int idle = 0;
+    while(!f_stop.load()) {
+        if(!m_frames.pop(frame)) {
+            if(f_captureDone.load() && m_frames.size() == 0)
+                break;
+            __backoff(idle);
+            continue;
+        }
+        idle = 0;
+        int64 tick = cv::getTickCount();
+        // period between captures, it does not depend on the processing time
+        period = frame.time - prevtime;
+        prevtime = frame.time;
+
+        p_faceproc->enrollImage(frame.image, result.value, proctime);
+        // frames dropped by the capture queue are replaced by the linear interpolation, PulseProcessor clips
+        // long periods, so a gap fed as one count would shorten the spectrum time base and bias heart rate upward
+        uint64 gap = first ? 1 : frame.index - previndex;
+        for(uint64 k = 1; k < gap; k++)
+            p_pulseproc->update(prevvalue + (result.value - prevvalue) * k / gap, period / gap);
+        p_pulseproc->update(result.value, period / gap);
+        prevvalue = result.value;
+        previndex = frame.index;
+        first = false;
+
+        result.image = frame.image;
+        result.index = frame.index;
+        result.time = frame.time;
+        result.vpg = p_pulseproc->getSignalSampleValue();
+        result.faceRect = p_faceproc->getFaceRect();
+        p_pulseproc->readResult(result.frequency, result.snr);
+        v_counters[Sink].dropped.fetch_add(m_results.pushDropOldest(result));
+
+        counters.processed.fetch_add(1);
+        counters.busy.fetch_add(cv::getTickCount() - tick);
+    }
+    // classifier of the shared model goes back to it, so the next start() does not build one more
+    p_faceproc->releaseThreadClassifier();
+    f_processDone.store(true);
+}
+
+void Pipeline::__estimateLoop()
+{
+    Counters &counters = v_counters[Estimate];
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!f_stop.load() && !f_processDone.load()) {
+        m_condition.wait_for(lock, std::chrono::microseconds(static_cast<int64>(m_measInterval * 1000.0)));
+        if(f_stop.load())
+            break;
+        int64 tick = cv::getTickCount();
+        p_pulseproc->computeFrequency(); // reads signal snapshot, update() is not blocked
+        counters.processed.fetch_add(1);
+        counters.busy.fetch_add(cv::getTickCount() - tick);
+    }
+}
+
+void Pipeline::__sinkLoop()
+{
+    Counters &counters = v_counters[Sink];
+    Result result;
+    int idle = 0;
+    while(!f_stop.load()) {
+        if(!m_results.pop(result)) {
+            if(f_processDone.load() && m_results.size() == 0)
+                break;
+            __backoff(idle);
+            continue;
+        }
+        idle = 0;
+        int64 tick = cv::getTickCount();
+        if(m_sink)
+            m_sink(result);
+        counters.processed.fetch_add(1);
+        counters.busy.fetch_add(cv::getTickCount() - tick);
+    }
+    f_sinkDone.store(true);
+}
+
+} // end of namespace vpg
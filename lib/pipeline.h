@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "vpg.h"
+#include "boundedqueue.h"
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The Pipeline class runs capture -> process -> estimate -> sink stages on separate threads,
+ * stages are connected by bounded lock-free queues, so decoding and output never throttle
+ * the measurement stage
+ */
+class DLLSPEC Pipeline
+{
+public:
+    enum Stage {Capture, Process, Estimate, Sink};
+    /**
+     * What capture stage does when process stage does not keep up
+     */
+    enum OverflowPolicy {Block, DropOldest};
+    /**
+     * Measurement of one frame, is passed to the sink
+     */
+    struct Result {
+        cv::Mat image;       // captured frame
+        uint64 index;        // frame index
+        double time;         // capture time in milliseconds since start(), for video files it is the video time of the frame end
+        double value;        // raw count returned by FaceProcessor::enrollImage
+        double vpg;          // PulseProcessor::getSignalSampleValue
+        double frequency;    // last heart rate estimation in bpm
+        double snr;          // last snr estimation in dB
+        cv::Rect faceRect;
+    };
+    /**
+     * Stage statistics
+     */
+    struct Metrics {
+        uint64 processed;    // number of items processed by the stage
+        uint64 dropped;      // number of items dropped from the stage input queue
+        double busy_ms;      // average processing time of one item
+        size_t queued;       // current length of the stage input queue
+    };
+    /**
+     * Default constructor, objects are not owned and should live until stop()
+     * @param capture - opened video source
+     * @param faceproc - face processor
+     * @param pulseproc - pulse processor, consider non positive period (see PulseProcessor)
+     * @param policy - capture queue overflow policy, use DropOldest for live sources and Block for video files
+     * @note counts of the frames dropped by DropOldest are interpolated from the neighbour frames, so the signal
+     * keeps the capture rate and heart rate is not biased, but the pulse harmonic is smoothed when drops are frequent
+     * @param queueCapacity - capacity of the each queue
+     */
+    Pipeline(cv::VideoCapture *capture, FaceProcessor *faceproc, PulseProcessor *pulseproc,
+             OverflowPolicy policy = DropOldest, size_t queueCapacity = 8);
+    /**
+     * Class destructor, stops the pipeline
+     */
+    virtual ~Pipeline();
+    /**
+     * Set function that is called by the sink stage for each processed frame (rendering, logging, etc.)
+     * @param sink - self explained
+     * @note sink queue always drops the oldest results, so slow sink does not delay measurements
+     */
+    void setSink(const std::function<void(const Result &)> &sink);
+    /**
+     * @brief set how often estimate stage calls PulseProcessor::computeFrequency()
+     * @param measInterval_ms - interval in milliseconds
+     */
+    void setMeasureInterval(double measInterval_ms);
+    /**
+     * Start stage threads
+     * @return false if pipeline is already running or video source is not opened
+     */
+    bool start();
+    /**
+     * Stop stage threads, pending items are discarded
+     */
+    void stop();
+    /**
+     * Wait until the video source ends and all queued frames are processed
+     */
+    void wait();
+    /**
+     * @brief self explained
+     * @return false when pipeline was stopped or video source has ended and all frames were processed
+     */
+    bool isRunning() const;
+    /**
+     * @brief get statistics of the stage
+     * @param stage - self explained
+     * @return self explained
+     */
+    Metrics getMetrics(Stage stage) const;
+
+private:
+    Pipeline(const Pipeline &);
+    Pipeline &operator=(const Pipeline &);
+
+    struct Frame {
+        cv::Mat image;
+        uint64 index;
+        double time;
+    };
+    struct Counters {
+        std::atomic<uint64> processed;
+        std::atomic<uint64> dropped;
+        std::atomic<int64> busy;
+    };
+
+    void __captureLoop();
+    void __processLoop();
+    void __estimateLoop();
+    void __sinkLoop();
+    void __join();
+    static void __backoff(int &idle);
+
+    cv::VideoCapture *p_capture;
+    FaceProcessor *p_faceproc;
+    PulseProcessor *p_pulseproc;
+    OverflowPolicy m_policy;
+    double m_measInterval;
+    std::function<void(const Result &)> m_sink;
+
+    BoundedQueue<Frame> m_frames;
+    BoundedQueue<Result> m_results;
+    Counters v_counters[4];
+
+    std::atomic<bool> f_stop;
+    std::atomic<bool> f_captureDone;
+    std::atomic<bool> f_processDone;
+    std::atomic<bool> f_sinkDone;
+    std::thread v_threads[4];
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    int64 m_startTick;
+    bool f_filesource;
+    double m_filePeriod;
+};
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#include "roiaccumulator.h"
+
+#include <cstring>
+
+namespace vpg {
+
+RoiAccumulator::RoiAccumulator()
+{
+    v_regions.push_back(cv::Rect2f(0.0f, 0.0f, 1.0f, 1.0f));
+    clear();
+}
+
+int RoiAccumulator::addRegion(const cv::Rect2f &relativeRect)
+{
+    if(static_cast<int>(v_regions.size()) == maxRegions)
+        return -1;
+    v_regions.push_back(relativeRect);
+    m_labelsSize = cv::Size(); // force labels to be rebuilt
+    return static_cast<int>(v_regions.size()) - 1;
+}
+
+int RoiAccumulator::getRegionsCount() const
+{
+    return static_cast<int>(v_regions.size());
+}
+
+double RoiAccumulator::getSum(int region, Channel channel) const
+{
+    return static_cast<double>(v_sums[region].sum[channel]);
+}
+
+double RoiAccumulator::getSquaresSum(int region, Channel channel) const
+{
+    return static_cast<double>(v_sums[region].squares[channel]);
+}
+
+unsigned long RoiAccumulator::getCount(int region) const
+{
+    return static_cast<unsigned long>(v_sums[region].count);
+}
+
+double RoiAccumulator::getMean(int region, Channel channel) const
+{
+    if(v_sums[region].count == 0)
+        return 0.0;
+    return getSum(region, channel) / v_sums[region].count;
+}
+
+double RoiAccumulator::getVariance(int region, Channel channel) const
+{
+    if(v_sums[region].count == 0)
+        return 0.0;
+    double mean = getMean(region, channel);
+    return getSquaresSum(region, channel) / v_sums[region].count - mean * mean;
+}
+
+void RoiAccumulator::getSample(std::vector<double> &sample) const
+{
+    sample.resize(v_regions.size() * sampleStride);
+    double *ptr = sample.data();
+    for(int r = 0; r < getRegionsCount(); r++) {
+        for(int c = 0; c < 3; c++) {
+            ptr[c] = getMean(r, static_cast<Channel>(c));
+            ptr[3 + c] = getVariance(r, static_cast<Channel>(c));
+        }
+        ptr[6] = static_cast<double>(v_sums[r].count);
+        ptr += sampleStride;
+    }
+}
+
+void RoiAccumulator::clear()
+{
+    std::memset(v_sums, 0, sizeof(v_sums));
+}
+
+void RoiAccumulator::__merge(const Sums *sums)
+{
+    for(int r = 0; r < maxRegions; r++) {
+        for(int c = 0; c < 3; c++) {
+            v_sums[r].sum[c] += sums[r].sum[c];
+            v_sums[r].squares[c] += sums[r].squares[c];
+        }
+        v_sums[r].count += sums[r].count;
+    }
+}
+
+void RoiAccumulator::__prepare(const cv::Size &size)
+{
+    if(m_labelsSize == size)
+        return;
+
+    // regions are rects, so pixel label is the intersection of its row and column labels,
+    // they are rebuilt in O(W + H) when the face rect size changes
+    m_labelsSize = size;
+    v_rowLabels.assign(size.height, 0);
+    v_colLabels.assign(size.width, 0);
+    for(size_t r = 0; r < v_regions.size(); r++) {
+        const cv::Rect2f &rr = v_regions[r];
+        cv::Rect rect = cv::Rect(static_cast<int>(rr.x * size.width), static_cast<int>(rr.y * size.height),
+                                 static_cast<int>(rr.width * size.width), static_cast<int>(rr.height * size.height))
+                        & cv::Rect(0, 0, size.width, size.height);
+        for(int j = rect.y; j < rect.y + rect.height; j++)
+            v_rowLabels[j] |= static_cast<uchar>(1 << r);
+        for(int i = rect.x; i < rect.x + rect.width; i++)
+            v_colLabels[i] |= static_cast<uchar>(1 << r);
+    }
+}
+
+} // end of namespace vpg
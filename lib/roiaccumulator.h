@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef ROIACCUMULATOR_H
+#define ROIACCUMULATOR_H
+
+#include "vpg.h"
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The RoiAccumulator class collects per channel statistics of the skin pixels
+ * for a set of face sub-regions, all regions are filled by FaceProcessor::enrollImage
+ * in one traversal of the face ROI
+ */
+class DLLSPEC RoiAccumulator
+{
+public:
+    enum Channel {Blue = 0, Green = 1, Red = 2};
+    /**
+     * Default constructor, creates region 0 that covers whole face rect
+     */
+    RoiAccumulator();
+    /**
+     * Add face sub-region
+     * @param relativeRect - rect in face rect coordinates normalized to [0.0, 1.0], e.g. (0.25, 0.0, 0.5, 0.2) is forehead
+     * @return index of the region or -1 if there are already maxRegions
+     */
+    int addRegion(const cv::Rect2f &relativeRect);
+    /**
+     * @brief self explained
+     * @return number of regions including region 0
+     */
+    int getRegionsCount() const;
+    /**
+     * @brief sum of channel values over the skin pixels of the region
+     */
+    double getSum(int region, Channel channel) const;
+    /**
+     * @brief sum of squared channel values over the skin pixels of the region
+     */
+    double getSquaresSum(int region, Channel channel) const;
+    /**
+     * @brief number of skin pixels in the region
+     */
+    unsigned long getCount(int region) const;
+    /**
+     * @brief mean channel value over the skin pixels of the region, 0.0 if there were no pixels
+     */
+    double getMean(int region, Channel channel) const;
+    /**
+     * @brief variance of channel value over the skin pixels of the region, 0.0 if there were no pixels
+     */
+    double getVariance(int region, Channel channel) const;
+    /**
+     * Get accumulated statistics as a vector sample
+     * @param sample - output, for each region: mean B, mean G, mean R, variance B, variance G, variance R, count
+     */
+    void getSample(std::vector<double> &sample) const;
+    /**
+     * Zero all sums, is called by FaceProcessor before each frame
+     */
+    void clear();
+
+    static const int maxRegions = 8;
+    static const int sampleStride = 7;
+
+private:
+    friend class FaceProcessor;
+
+    struct Sums {
+        uint64 sum[3];
+        uint64 squares[3];
+        uint64 count;
+    };
+
+    void __prepare(const cv::Size &size);
+    void __merge(const Sums *sums);
+    static inline void __add(Sums *sums, uchar labels, uchar vB, uchar vG, uchar vR)
+    {
+        for(int r = 0; labels != 0; r++, labels >>= 1)
+            if(labels & 1) {
+                Sums &s = sums[r];
+                s.sum[0] += vB;
+                s.sum[1] += vG;
+                s.sum[2] += vR;
+                s.squares[0] += vB * vB;
+                s.squares[1] += vG * vG;
+                s.squares[2] += vR * vR;
+                s.count++;
+            }
+    }
+
+    std::vector<cv::Rect2f> v_regions;
+    Sums v_sums[maxRegions];
+    // bit r of the label is set if pixel belongs to the region r, pixel label is v_rowLabels[j] & v_colLabels[i]
+    std::vector<uchar> v_rowLabels;
+    std::vector<uchar> v_colLabels;
+    cv::Size m_labelsSize;
+};
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#include "signalrecorder.h"
+
+#include <cstring>
+#include <chrono>
+
+namespace vpg {
+
+static const char recordMagic[4] = {'V','P','G','R'};
+static const unsigned int recordVersion = 1;
+
+SignalRecorder::SignalRecorder(unsigned int capacity) :
+    m_head(0),
+    m_tail(0),
+    m_dropped(0),
+    f_stop(false),
+    m_file(0)
+{
+    m_capacity = capacity < 4 ? 4 : capacity;
+    v_records = new Record[m_capacity];
+}
+
+SignalRecorder::~SignalRecorder()
+{
+    close();
+    delete[] v_records;
+}
+
+bool SignalRecorder::open(const std::string &filename)
+{
+    close();
+    m_file = std::fopen(filename.c_str(), "wb");
+    if(m_file == 0)
+        return false;
+
+    unsigned int header[headerSize / sizeof(unsigned int)] = {0, recordVersion, static_cast<unsigned int>(sizeof(Record)), 0};
+    std::memcpy(header, recordMagic, sizeof(recordMagic));
+    if(std::fwrite(header, sizeof(header), 1, m_file) != 1) {
+        std::fclose(m_file);
+        m_file = 0;
+        return false;
+    }
+
+    m_head.store(0);
+    m_tail.store(0);
+    m_dropped.store(0);
+    f_stop.store(false);
+    m_thread = std::thread(&SignalRecorder::__flushLoop, this);
+    return true;
+}
+
+void SignalRecorder::close()
+{
+    if(m_file == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        f_stop.store(true);
+    }
+    m_condition.notify_one();
+    m_thread.join();
+    std::fclose(m_file);
+    m_file = 0;
+}
+
+bool SignalRecorder::isOpened() const
+{
+    return m_file != 0;
+}
+
+bool SignalRecorder::write(const Record &record)
+{
+    unsigned long head = m_head.load(std::memory_order_relaxed);
+    if(head - m_tail.load(std::memory_order_acquire) >= m_capacity) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::memcpy(&v_records[head % m_capacity], &record, sizeof(Record));
+    m_head.store(head + 1, std::memory_order_release);
+    // wake up the flusher when quarter of the ring is filled, else it wakes up by timeout
+    if(((head + 1) % (m_capacity / 4)) == 0)
+        m_condition.notify_one();
+    return true;
+}
+
+bool SignalRecorder::write(uint64 frame, double time, double raw, double vpg, double hr, double snr, const cv::Rect &rect)
+{
+    Record record;
+    record.frame = frame;
+    record.time = time;
+    record.raw = raw;
+    record.vpg = vpg;
+    record.hr = hr;
+    record.snr = snr;
+    record.x = rect.x;
+    record.y = rect.y;
+    record.width = rect.width;
+    record.height = rect.height;
+    return write(record);
+}
+
+unsigned long SignalRecorder::getDropped() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+void SignalRecorder::__flushLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(f_stop.load() == false) {
+        m_condition.wait_for(lock, std::chrono::milliseconds(100));
+        __flush();
+    }
+    __flush();
+}
+
+void SignalRecorder::__flush()
+{
+    unsigned long head = m_head.load(std::memory_order_acquire);
+    unsigned long tail = m_tail.load(std::memory_order_relaxed);
+    if(tail == head)
+        return;
+    while(tail != head) {
+        unsigned long begin = tail % m_capacity;
+        unsigned long count = std::min<unsigned long>(head - tail, m_capacity - begin);
+        std::fwrite(&v_records[begin], sizeof(Record), count, m_file);
+        tail += count;
+        m_tail.store(tail, std::memory_order_release);
+    }
+    std::fflush(m_file);
+}
+
+bool SignalRecorder::checkHeader(const void *header)
+{
+    const unsigned int *fields = static_cast<const unsigned int *>(header);
+    if(std::memcmp(header, recordMagic, sizeof(recordMagic)) != 0 || fields[1] != recordVersion || fields[2] != sizeof(Record))
+        return false;
+    return true;
+}
+
+bool SignalRecorder::convertToCSV(const std::string &binfilename, const std::string &csvfilename)
+{
+    std::FILE *ifile = std::fopen(binfilename.c_str(), "rb");
+    if(ifile == 0)
+        return false;
+    unsigned int header[headerSize / sizeof(unsigned int)];
+    if(std::fread(header, headerSize, 1, ifile) != 1 || checkHeader(header) == false) {
+        std::fclose(ifile);
+        return false;
+    }
+    std::FILE *ofile = std::fopen(csvfilename.c_str(), "w");
+    if(ofile == 0) {
+        std::fclose(ifile);
+        return false;
+    }
+
+    std::fprintf(ofile, "Frame;Time[ms];Raw;VPG[c.n.];HR[bpm];SNR[dB];X;Y;Width;Height\n");
+    Record records[1024];
+    size_t count = 0;
+    while((count = std::fread(records, sizeof(Record), 1024, ifile)) > 0) {
+        for(size_t i = 0; i < count; i++) {
+            const Record &r = records[i];
+            std::fprintf(ofile, "%llu;%.3f;%.4f;%.4f;%.1f;%.2f;%d;%d;%d;%d\n",
+                         static_cast<unsigned long long>(r.frame), r.time, r.raw, r.vpg, r.hr, r.snr,
+                         r.x, r.y, r.width, r.height);
+        }
+    }
+
+    std::fclose(ifile);
+    std::fclose(ofile);
+    return true;
+}
+
+} // end of namespace vpg
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef SIGNALRECORDER_H
+#define SIGNALRECORDER_H
+
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "vpg.h"
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The SignalRecorder class writes per frame VPG/HR records into a compact binary file.
+ * Records are copied into a preallocated ring buffer by the caller thread and are flushed
+ * to disk by a background thread, so the capture loop never waits for the storage
+ */
+class DLLSPEC SignalRecorder
+{
+public:
+    /**
+     * Binary record, one per enrolled frame (64 bytes, native byte order)
+     */
+    struct Record {
+        uint64 frame;   // frame index
+        double time;    // timestamp in milliseconds since the record start
+        double raw;     // raw count returned by FaceProcessor::enrollImage
+        double vpg;     // centered and normalized count, PulseProcessor::getSignalSampleValue
+        double hr;      // last heart rate estimation in bpm
+        double snr;     // last snr estimation in dB
+        int x, y, width, height; // face rect
+    };
+    /**
+     * Default constructor
+     * @param capacity - length of the ring buffer in records
+     */
+    SignalRecorder(unsigned int capacity = 4096);
+    /**
+     * Class destructor, flushes and closes the file
+     */
+    virtual ~SignalRecorder();
+    /**
+     * Create binary file and start background flushing
+     * @param filename - name of the output file
+     * @return was file opened or not
+     */
+    bool open(const std::string &filename);
+    /**
+     * Flush all pending records and close the file
+     */
+    void close();
+    /**
+     * @brief self explained
+     * @return is file opened
+     */
+    bool isOpened() const;
+    /**
+     * Enqueue one record, costs one memcpy
+     * @param record - record to write
+     * @return false if ring buffer is full and the record has been dropped
+     * @note should be called from one thread only
+     */
+    bool write(const Record &record);
+    /**
+     * Overloaded function, packs the record from the separate values
+     */
+    bool write(uint64 frame, double time, double raw, double vpg, double hr, double snr, const cv::Rect &rect);
+    /**
+     * @brief get number of records that were dropped because of the ring buffer overflow
+     * @return self explained
+     */
+    unsigned long getDropped() const;
+    /**
+     * Convert binary record file into semicolon separated text file
+     * @param binfilename - name of the file created by SignalRecorder
+     * @param csvfilename - name of the output text file
+     * @return was conversion successful or not
+     */
+    static bool convertToCSV(const std::string &binfilename, const std::string &csvfilename);
+    /**
+     * Check header of the binary record file
+     * @param header - pointer to the first headerSize bytes of the file
+     * @return true if header is valid
+     */
+    static bool checkHeader(const void *header);
+
+    static const unsigned int headerSize = 16;
+
+private:
+    SignalRecorder(const SignalRecorder &);
+    SignalRecorder &operator=(const SignalRecorder &);
+
+    void __flushLoop();
+    void __flush();
+
+    Record *v_records;
+    unsigned int m_capacity;
+    std::atomic<unsigned long> m_head;
+    std::atomic<unsigned long> m_tail;
+    std::atomic<unsigned long> m_dropped;
+    std::atomic<bool> f_stop;
+    std::FILE *m_file;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+};
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
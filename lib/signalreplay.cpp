@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#include "signalreplay.h"
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace vpg {
+
+SignalReplay::SignalReplay() :
+    v_records(0),
+    m_count(0),
+    m_mapping(0),
+    m_mappingsize(0)
+#ifdef _WIN32
+    ,m_filehandle(INVALID_HANDLE_VALUE)
+    ,m_maphandle(0)
+#endif
+{}
+
+SignalReplay::~SignalReplay()
+{
+    close();
+}
+
+bool SignalReplay::open(const std::string &filename)
+{
+    close();
+#ifdef _WIN32
+    m_filehandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(m_filehandle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(m_filehandle, &size) == 0 || size.QuadPart < static_cast<LONGLONG>(SignalRecorder::headerSize)) {
+        close();
+        return false;
+    }
+    m_mappingsize = static_cast<size_t>(size.QuadPart);
+    m_maphandle = CreateFileMappingA(m_filehandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(m_maphandle == 0) {
+        close();
+        return false;
+    }
+    m_mapping = MapViewOfFile(m_maphandle, FILE_MAP_READ, 0, 0, 0);
+    if(m_mapping == 0) {
+        close();
+        return false;
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(SignalRecorder::headerSize)) {
+        ::close(fd);
+        return false;
+    }
+    m_mappingsize = static_cast<size_t>(st.st_size);
+    void *mapping = mmap(0, m_mappingsize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // mapping keeps its own reference to the file
+    if(mapping == MAP_FAILED) {
+        m_mappingsize = 0;
+        return false;
+    }
+    m_mapping = mapping;
+    madvise(m_mapping, m_mappingsize, MADV_SEQUENTIAL);
+#endif
+    if(SignalRecorder::checkHeader(m_mapping) == false) {
+        close();
+        return false;
+    }
+    v_records = reinterpret_cast<const SignalRecorder::Record *>(static_cast<const char *>(m_mapping) + SignalRecorder::headerSize);
+    m_count = (m_mappingsize - SignalRecorder::headerSize) / sizeof(SignalRecorder::Record);
+    return true;
+}
+
+void SignalReplay::close()
+{
+#ifdef _WIN32
+    if(m_mapping != 0)
+        UnmapViewOfFile(m_mapping);
+    if(m_maphandle != 0)
+        CloseHandle(m_maphandle);
+    if(m_filehandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_filehandle);
+    m_maphandle = 0;
+    m_filehandle = INVALID_HANDLE_VALUE;
+#else
+    if(m_mapping != 0)
+        munmap(m_mapping, m_mappingsize);
+#endif
+    m_mapping = 0;
+    m_mappingsize = 0;
+    v_records = 0;
+    m_count = 0;
+}
+
+bool SignalReplay::isOpened() const
+{
+    return m_mapping != 0;
+}
+
+size_t SignalReplay::getCount() const
+{
+    return m_count;
+}
+
+const SignalRecorder::Record *SignalReplay::getRecords() const
+{
+    return v_records;
+}
+
+double SignalReplay::getFramePeriod() const
+{
+    return getFramePeriod(v_records, m_count);
+}
+
+double SignalReplay::getFramePeriod(const SignalRecorder::Record *records, size_t count)
+{
+    if(count < 2)
+        return -1.0;
+    return (records[count - 1].time - records[0].time) / (count - 1);
+}
+
+size_t SignalReplay::replay(PulseProcessor &proc, double measInterval_ms, std::vector<double> *hr, std::vector<double> *snr, std::vector<bool> *fresh) const
+{
+    return replay(v_records, m_count, proc, measInterval_ms, hr, snr, fresh);
+}
+
+size_t SignalReplay::replay(const SignalRecorder::Record *records, size_t count, PulseProcessor &proc, double measInterval_ms, std::vector<double> *hr, std::vector<double> *snr,
+                            std::vector<bool> *fresh)
+{
+    double prevtime = 0.0, timeout = measInterval_ms;
+    for(size_t i = 0; i < count; i++) {
+        // record time is cumulative, processor expects the time elapsed since the previous count
+        double dt = records[i].time - prevtime;
+        prevtime = records[i].time;
+        proc.update(records[i].raw, dt);
+        if(measInterval_ms > 0.0) {
+            timeout -= dt;
+            if(timeout < 0.0) {
+                double frequency = proc.computeFrequency();
+                if(hr)
+                    hr->push_back(frequency);
+                if(snr)
+                    snr->push_back(proc.getSNR());
+                if(fresh)
+                    fresh->push_back(proc.isFrequencyFresh());
+                timeout = measInterval_ms;
+            }
+        }
+    }
+    return count;
+}
+
+} // end of namespace vpg
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef SIGNALREPLAY_H
+#define SIGNALREPLAY_H
+
+#include "signalrecorder.h"
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The SignalReplay class memory maps binary record file (see SignalRecorder)
+ * and feeds recorded counts to PulseProcessor as fast as possible,
+ * records are neither parsed nor copied
+ */
+class DLLSPEC SignalReplay
+{
+public:
+    /**
+     * Default constructor
+     */
+    SignalReplay();
+    /**
+     * Class destructor, unmaps the file
+     */
+    virtual ~SignalReplay();
+    /**
+     * Map binary record file into memory
+     * @param filename - name of the file created by SignalRecorder
+     * @return was file mapped or not
+     */
+    bool open(const std::string &filename);
+    /**
+     * Unmap the file
+     */
+    void close();
+    /**
+     * @brief self explained
+     * @return is file mapped
+     */
+    bool isOpened() const;
+    /**
+     * @brief get number of records
+     * @return self explained
+     */
+    size_t getCount() const;
+    /**
+     * @brief get pointer to the mapped records
+     * @return pointer to the first record, valid until close()
+     */
+    const SignalRecorder::Record *getRecords() const;
+    /**
+     * @brief get average frame period of the record
+     * @return period in milliseconds or -1.0 if there are not enough records
+     */
+    double getFramePeriod() const;
+    /**
+     * Feed all mapped records to the PulseProcessor
+     * @param proc - target processor
+     * @param measInterval_ms - heart rate is computed each time this interval of record time elapses
+     * @param hr - optional output for heart rate measurements
+     * @param snr - optional output for snr measurements
+     * @param fresh - optional output, false where snr was below the threshold and the previous heart rate was repeated
+     * @return number of records that have been fed
+     */
+    size_t replay(PulseProcessor &proc, double measInterval_ms = 1000.0, std::vector<double> *hr = 0, std::vector<double> *snr = 0,
+                  std::vector<bool> *fresh = 0) const;
+    /**
+     * Overloaded function, feeds records from arbitrary memory
+     * @param records - pointer to the first record
+     * @param count - number of records
+     */
+    static size_t replay(const SignalRecorder::Record *records, size_t count, PulseProcessor &proc, double measInterval_ms = 1000.0, std::vector<double> *hr = 0, std::vector<double> *snr = 0,
+                         std::vector<bool> *fresh = 0);
+    /**
+     * Overloaded function
+     * @param records - pointer to the first record
+     * @param count - number of records
+     * @return average frame period in milliseconds or -1.0 if there are not enough records
+     */
+    static double getFramePeriod(const SignalRecorder::Record *records, size_t count);
+
+private:
+    SignalReplay(const SignalReplay &);
+    SignalReplay &operator=(const SignalReplay &);
+
+    const SignalRecorder::Record *v_records;
+    size_t m_count;
+    void *m_mapping;
+    size_t m_mappingsize;
+#ifdef _WIN32
+    void *m_filehandle;
+    void *m_maphandle;
+#endif
+};
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#include "threadpool.h"
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace vpg {
+
+#define THREAD_POOL_SPIN_COUNT 4096
+
+ThreadPool::ThreadPool(unsigned int threads, bool pinThreads) :
+    m_generation(0),
+    m_claim(0),
+    m_remaining(0),
+    f_stop(false),
+    m_tiles(0),
+    m_begin(0),
+    m_end(0),
+    m_grain(1),
+    p_body(0)
+{
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for(unsigned int i = 1; i < threads; i++) {
+        v_workers.push_back(std::thread(&ThreadPool::__workerLoop, this, i));
+#ifdef __linux__
+        if(pinThreads) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cpuset);
+            pthread_setaffinity_np(v_workers.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+        }
+#else
+        (void)pinThreads;
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        f_stop = true;
+        m_generation.fetch_add(1);
+        m_claim.store(0);
+    }
+    m_condition.notify_all();
+    for(size_t i = 0; i < v_workers.size(); i++)
+        v_workers[i].join();
+}
+
+unsigned int ThreadPool::getThreadsCount() const
+{
+    return static_cast<unsigned int>(v_workers.size()) + 1;
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int, unsigned int)> &body)
+{
+    if(grain < 1)
+        grain = 1;
+    std::unique_lock<std::mutex> dispatch(m_dispatchmutex, std::try_to_lock);
+    if(!dispatch.owns_lock() || v_workers.empty() || (end - begin) <= grain) {
+        for(int i = begin; i < end; i += grain)
+            body(i, std::min(i + grain, end), 0);
+        return;
+    }
+
+    unsigned int generation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        p_body = &body;
+        m_begin = begin;
+        m_end = end;
+        m_grain = grain;
+        int tiles = (end - begin + grain - 1) / grain;
+        m_tiles.store(tiles, std::memory_order_relaxed);
+        m_remaining.store(tiles, std::memory_order_relaxed);
+        generation = m_generation.load(std::memory_order_relaxed) + 1;
+        m_claim.store(static_cast<unsigned long long>(generation) << 32, std::memory_order_release);
+        m_generation.store(generation, std::memory_order_release);
+    }
+    m_condition.notify_all();
+
+    __runTiles(generation, 0);
+    // only tiles that were taken by the workers are waited for, sleeping workers are not
+    while(m_remaining.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+}
+
+void ThreadPool::__workerLoop(unsigned int index)
+{
+    unsigned int generation = 0;
+    while(true) {
+        // spin shortly, frames come often, then sleep
+        int spin = 0;
+        while(m_generation.load(std::memory_order_acquire) == generation && spin < THREAD_POOL_SPIN_COUNT)
+            spin++;
+        if(m_generation.load(std::memory_order_acquire) == generation) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while(m_generation.load() == generation)
+                m_condition.wait(lock);
+        }
+        generation = m_generation.load(std::memory_order_acquire);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(f_stop)
+                return;
+        }
+        __runTiles(generation, index);
+    }
+}
+
+void ThreadPool::__runTiles(unsigned int generation, unsigned int index)
+{
+    // a tile is claimed only while its loop is current, so a late worker does not touch the finished loop,
+    // loop parameters are stable until the claimed tile is finished
+    unsigned long long claim = m_claim.load(std::memory_order_acquire);
+    while(true) {
+        if(static_cast<unsigned int>(claim >> 32) != generation)
+            return;
+        int tile = static_cast<int>(claim & 0xFFFFFFFFull);
+        if(tile >= m_tiles.load(std::memory_order_relaxed))
+            return;
+        if(m_claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            int i = m_begin + tile * m_grain;
+            (*p_body)(i, std::min(i + m_grain, m_end), index);
+            m_remaining.fetch_sub(1, std::memory_order_release);
+            claim = m_claim.load(std::memory_order_acquire);
+        }
+    }
+}
+
+} // end of namespace vpg
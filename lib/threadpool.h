@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2015, Taranov Alex <pi-null-mezon@yandex.ru>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+#include "vpg.h"
+
+namespace vpg {
+//-------------------------------------------------------
+/**
+ * The ThreadPool class keeps persistent worker threads for the data parallel loops,
+ * so per frame loops do not pay for the threads creation and parallel region fork/join
+ */
+class DLLSPEC ThreadPool
+{
+public:
+    /**
+     * Default constructor
+     * @param threads - total number of threads including the calling one, 0 means number of hardware threads
+     * @param pinThreads - bind each worker to its own core (Linux only, ignored elsewhere)
+     */
+    ThreadPool(unsigned int threads = 0, bool pinThreads = false);
+    /**
+     * Class destructor, stops workers
+     */
+    virtual ~ThreadPool();
+    /**
+     * @brief self explained
+     * @return number of threads including the calling one
+     */
+    unsigned int getThreadsCount() const;
+    /**
+     * Split [begin, end) into tiles of grain indexes and process them by the workers and the calling thread
+     * @param begin - first index
+     * @param end - index after the last one
+     * @param grain - tile size in indexes
+     * @param body - called for each tile with its bounds and the index of the thread in [0, getThreadsCount())
+     * @note if the pool is busy with the call from another thread, all tiles are processed by the calling thread
+     */
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int, unsigned int)> &body);
+
+private:
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+
+    void __workerLoop(unsigned int index);
+    void __runTiles(unsigned int generation, unsigned int index);
+
+    std::vector<std::thread> v_workers;
+    std::mutex m_dispatchmutex;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::atomic<unsigned int> m_generation;
+    std::atomic<unsigned long long> m_claim; // generation in the high half, next tile in the low half
+    std::atomic<int> m_remaining; // tiles that are not finished yet
+    bool f_stop;
+    std::atomic<int> m_tiles; // could be read by a late worker while the next loop is set up
+    int m_begin;
+    int m_end;
+    int m_grain;
+    const std::function<void(int, int, unsigned int)> *p_body;
+};
+//-------------------------------------------------------
+} // end of namespace vpg
+
+#endif
@@ -17,10 +17,26 @@
  */
 
 #include "vpg.h"
+#include "roiaccumulator.h"
+#include "facedetectormodel.h"
+#include "threadpool.h"
+
+#include <thread>
+#include <algorithm>
 
 namespace vpg {
 
 //---------------------------------PulseProcessor--------------------------------
+
+#define PULSE_PROCESSOR_GUESS_PERIOD 33.0
+#define PULSE_PROCESSOR_MIN_PERIOD 10.0
+#define PULSE_PROCESSOR_SNR_THRESHOLD 2.0 // dB
+#define PULSE_PROCESSOR_FASTLOCK_MS 2000.0 // minimum record length for the autoregression estimation
+#define PULSE_PROCESSOR_BURG_SNR_THRESHOLD 16.0 // dB, power density ratio, see __computeBurg(), pure noise passes it in about 0.1% of estimations
+#define PULSE_PROCESSOR_BURG_ORDER 8
+#define PULSE_PROCESSOR_BURG_STEP 0.01 // Hz
+#define PULSE_PROCESSOR_BURG_PEAK 0.15 // Hz, half width of the pulse harmonic
+
 PulseProcessor::PulseProcessor(double dT_ms, ProcessType type)
 {
     switch(type){
@@ -37,37 +53,89 @@ PulseProcessor::PulseProcessor(double Tov_ms, double Tcn_ms, double Tlpf_ms, dou
 
 void PulseProcessor::__init(double Tov_ms, double Tcn_ms, double Tlpf_ms, double dT_ms, ProcessType type)
 {
+    v_raw = 0;
+    v_Y = 0;
+    v_time = 0;
+    v_FA = 0;
+    v_X = 0;
+    f_fastlock = false;
+    m_capacity = 0;
+    m_filtercapacity = 0;
+    m_signalseq.store(0);
+    m_resultseq.store(0);
+    reconfigure(Tov_ms, Tcn_ms, Tlpf_ms, dT_ms, type);
+}
+
+void PulseProcessor::reconfigure(double Tov_ms, double Tcn_ms, double Tlpf_ms, double dT_ms, ProcessType type)
+{
+    m_Tovms = Tov_ms;
+    m_Tcnms = Tcn_ms;
+    m_Tlpfms = Tlpf_ms;
+    // unknown period, start with a guess and reserve storage for the shortest supported period
+    f_autoperiod = (dT_ms <= 0.0);
+    double capacityPeriod = dT_ms;
+    if(f_autoperiod) {
+        dT_ms = PULSE_PROCESSOR_GUESS_PERIOD;
+        capacityPeriod = PULSE_PROCESSOR_MIN_PERIOD;
+    }
+
     m_dTms = dT_ms;
     m_length = static_cast<int>( Tov_ms / dT_ms );
     m_filterlength = static_cast<int>( Tlpf_ms / dT_ms );
 
     switch(type){
         case HeartRate:
-            m_Frequency = -1.0;
             m_interval = static_cast<int>( Tcn_ms/ dT_ms );
             m_bottomFrequencyLimit = 0.8; // 48 bpm
             m_topFrequencyLimit = 3.0;    // 180 bpm
             break;        
     }
 
-    v_raw = new double[m_length];
-    v_Y = new double[m_length];
-    v_time = new double[m_length];
-    v_FA = new double[m_length/2 + 1];
+    // storage is reallocated only if it is not enough for the new windows
+    int capacity = static_cast<int>( Tov_ms / capacityPeriod );
+    if(capacity > m_capacity) {
+        delete[] v_raw;
+        delete[] v_Y;
+        delete[] v_time;
+        delete[] v_FA;
+        m_capacity = capacity;
+        v_raw = new double[m_capacity];
+        v_Y = new double[m_capacity];
+        v_time = new double[m_capacity];
+        v_FA = new double[m_capacity/2 + 1];
+        v_datamat = cv::Mat(1, m_capacity, CV_64F);
+    }
+    int filtercapacity = static_cast<int>( Tlpf_ms / capacityPeriod );
+    if(filtercapacity > m_filtercapacity) {
+        delete[] v_X;
+        m_filtercapacity = filtercapacity;
+        v_X = new double[m_filtercapacity];
+    }
+
+    reset();
+}
 
-    for(int i = 0; i < m_length; i++)  {
+void PulseProcessor::reset()
+{
+    __writeBegin(m_signalseq);
+    for(int i = 0; i < m_capacity; i++)  {
         v_raw[i] = 0.0;
         v_Y[i] = 0.0;
-        v_time[i] = dT_ms;
+        v_time[i] = m_dTms;
     }
-    v_X = new double[m_filterlength];
-    for(int i = 0; i < m_filterlength; i ++)
+    for(int i = 0; i < m_filtercapacity; i ++)
 		v_X[i] = (double)i;
+    curpos = 0;
+    m_count = 0;
+    __writeEnd(m_signalseq);
 
-    v_datamat = cv::Mat(1, m_length, CV_64F);
-    v_dftmat = cv::Mat(1, m_length, CV_64F);
+    m_periodcount = -1; // first count is excluded because it could be delayed
 
-    curpos = 0;
+    __writeBegin(m_resultseq);
+    m_Frequency = -1.0;
+    m_snr = 0.0;
+    f_fresh = false;
+    __writeEnd(m_resultseq);
 }
 
 PulseProcessor::~PulseProcessor()
@@ -79,14 +147,86 @@ PulseProcessor::~PulseProcessor()
     delete[] v_FA;
 }
 
+void PulseProcessor::__estimatePeriod(double time)
+{
+    if(m_periodcount < 0) {
+        m_periodcount = 0;
+        return;
+    }
+    if(time <= 0.0)
+        return;
+    v_periods[m_periodcount++] = time;
+    if(m_periodcount == periodBlock) {
+        // obviously delayed or doubled counts are rejected against the median of the block itself,
+        // so the guessed period does not gate slow cameras out
+        double sorted[periodBlock];
+        std::copy(v_periods, v_periods + m_periodcount, sorted);
+        std::nth_element(sorted, sorted + m_periodcount / 2, sorted + m_periodcount);
+        double median = sorted[m_periodcount / 2];
+        double sum = 0.0;
+        int count = 0;
+        for(int i = 0; i < m_periodcount; i++)
+            if(v_periods[i] > 0.5 * median && v_periods[i] < 2.0 * median) {
+                sum += v_periods[i];
+                count++;
+            }
+        double period = std::max(sum / count, PULSE_PROCESSOR_MIN_PERIOD); // median itself is always counted
+        // centering needs two counts and the filter one at least, slower cameras (stalls, low light) are processed
+        // with the longest period the windows allow, their true times are still used by the spectrum while below 2*period
+        period = std::min(period, std::min(m_Tcnms / 2.0, m_Tlpfms));
+        if(std::abs(period - m_dTms) > 0.1 * m_dTms)
+            __rescale(period);
+        m_periodcount = 0;
+    }
+}
+
+void PulseProcessor::__rescale(double dT_ms)
+{
+    int length = std::min(static_cast<int>( m_Tovms / dT_ms ), m_capacity);
+    int filterlength = std::min(static_cast<int>( m_Tlpfms / dT_ms ), m_filtercapacity);
+    int copy = std::min(length, m_length);
+    int filtercopy = std::min(filterlength, m_filterlength);
+    // keep the newest counts, they are placed in front of the new position 0
+    std::vector<double> raw(copy), Y(copy), X(filtercopy);
+    for(int i = 0; i < copy; i++) {
+        raw[i] = v_raw[__loop(curpos - 1 - i)];
+        Y[i] = v_Y[__loop(curpos - 1 - i)];
+    }
+    for(int i = 0; i < filtercopy; i++)
+        X[i] = v_X[__seek(curpos - 1 - i)];
+
+    __writeBegin(m_signalseq);
+    m_dTms = dT_ms;
+    m_length = length;
+    m_filterlength = filterlength;
+    m_interval = static_cast<int>( m_Tcnms / dT_ms );
+    curpos = 0;
+    m_count = std::min(m_count, copy);
+    for(int i = 0; i < m_length; i++) {
+        v_raw[i] = 0.0;
+        v_Y[i] = 0.0;
+        v_time[i] = dT_ms; // previous times were clipped by the guessed period
+    }
+    for(int i = 0; i < copy; i++) {
+        v_raw[__loop(-1 - i)] = raw[i];
+        v_Y[__loop(-1 - i)] = Y[i];
+    }
+    for(int i = 0; i < filtercopy; i++)
+        v_X[__seek(-1 - i)] = X[i];
+    __writeEnd(m_signalseq);
+}
+
+double PulseProcessor::getFramePeriod() const
+{
+    return m_dTms;
+}
+
 void PulseProcessor::update(double value, double time)
 {
+    if(f_autoperiod)
+        __estimatePeriod(time);
+
     v_raw[curpos] = value;
-    if(std::abs(time - m_dTms) < m_dTms) {
-        v_time[curpos] = time;
-    } else {
-        v_time[curpos] = m_dTms;
-    }
 
     double mean = 0.0;
     double sko = 0.0;
@@ -113,40 +253,86 @@ void PulseProcessor::update(double value, double time)
         integral += v_X[i];
     }
 
-    v_Y[curpos] = ( integral + v_Y[__loop(curpos - 1)] )  / (m_filterlength + 1.0);
+    double y = ( integral + v_Y[__loop(curpos - 1)] )  / (m_filterlength + 1.0);
 
-    curpos = (++curpos) % m_length;
+    // publish the count, concurrent readers retry if they see odd or changed sequence
+    __writeBegin(m_signalseq);
+    if(std::abs(time - m_dTms) < m_dTms) {
+        v_time[curpos] = time;
+    } else {
+        v_time[curpos] = m_dTms;
+    }
+    v_Y[curpos] = y;
+    curpos = (curpos + 1) % m_length;
+    if(m_count < m_length)
+        m_count++;
+    __writeEnd(m_signalseq);
 }
 
 double PulseProcessor::computeFrequency()
 {
-    double time = 0.0;
-    for (int i = 0; i < m_length; i++)
-        time += v_time[i];
+    double time;
+    int length, count, transient;
+    double *pt = v_datamat.ptr<double>(0);
+    unsigned int seq;
+    do {
+        seq = __readBegin(m_signalseq);
+        // length could be changed by the frame period estimation in update()
+        length = m_length;
+        count = m_count;
+        transient = m_interval + m_filterlength;
+        time = 0.0;
+        for (int i = 0; i < length; i++)
+            time += v_time[i];
+        int pos = curpos;
+        for(int i = 0; i < length; i++)
+            pt[i] = v_Y[(pos - 1 - i + length) % length];
+    } while(__readRetry(m_signalseq, seq));
+
+    double frequency = -1.0, snr = 0.0, threshold = PULSE_PROCESSOR_SNR_THRESHOLD;
+    if(f_fastlock && count < length) {
+        // window is not filled yet, periodogram would be dominated by the zero counts,
+        // the oldest counts are skipped also, they hold the transient of the centering and filter windows
+        double period = time / length;
+        int fitcount = count - transient;
+        threshold = PULSE_PROCESSOR_BURG_SNR_THRESHOLD;
+        if(fitcount * period >= PULSE_PROCESSOR_FASTLOCK_MS)
+            __computeBurg(pt, fitcount, period, frequency, snr);
+    } else {
+        __computePeriodogram(length, time, frequency, snr);
+    }
 
+    __writeBegin(m_resultseq);
+    m_snr = snr;
+    f_fresh = m_snr > threshold;
+    if(f_fresh)
+        m_Frequency = frequency;
+    frequency = m_Frequency;
+    __writeEnd(m_resultseq);
 
-    double *pt = v_datamat.ptr<double>(0);
-    for(int i = 0; i < m_length; i++)
-        pt[i] = v_Y[__loop(curpos - 1 - i)];
+    return frequency;
+}
 
-    cv::dft(v_datamat, v_dftmat);
+void PulseProcessor::__computePeriodogram(int length, double time, double &frequency, double &snr)
+{
+    cv::dft(v_datamat.colRange(0, length), v_dftmat);
     const double *v_fft = v_dftmat.ptr<const double>(0);
 
     // complex-conjugate-symmetrical array
     v_FA[0] = v_fft[0]*v_fft[0];
-    if((m_length % 2) == 0) { // Even number of counts
-        for(int i = 1; i < m_length/2; i++)
+    if((length % 2) == 0) { // Even number of counts
+        for(int i = 1; i < length/2; i++)
             v_FA[i] = v_fft[2*i-1]*v_fft[2*i-1] + v_fft[2*i]*v_fft[2*i];
-        v_FA[m_length/2] = v_fft[m_length-1]*v_fft[m_length-1];
+        v_FA[length/2] = v_fft[length-1]*v_fft[length-1];
     } else { // Odd number of counts
-        for(int i = 1; i <= m_length/2; i++)
+        for(int i = 1; i <= length/2; i++)
             v_FA[i] = v_fft[2*i-1]*v_fft[2*i-1] + v_fft[2*i]*v_fft[2*i];
     }
 
     int bottom = (int)(m_bottomFrequencyLimit * time / 1000.0);
     int top = (int)(m_topFrequencyLimit * time / 1000.0);
-    if(top > (m_length/2))
-        top = m_length/2;
+    if(top > (length/2))
+        top = length/2;
     int i_maxpower = 0;
     double maxpower = 0.0;
     for (int i = bottom + 2 ; i <= top - 2; i++)
@@ -167,16 +353,128 @@ double PulseProcessor::computeFrequency()
         }
     }
 
-    m_snr = 0.0;
+    snr = 0.0;
+    frequency = -1.0;
     if(signal_power > 0.01) {
-        m_snr = 10.0 * std::log10( signal_power / noise_power );
+        snr = 10.0 * std::log10( signal_power / noise_power );
         double bias = (double)i_maxpower - ( signal_moment / signal_power );
-        m_snr *= (1.0 / (1.0 + bias*bias));
+        snr *= (1.0 / (1.0 + bias*bias));
+        frequency = (signal_moment / signal_power) * 60000.0 / time;
+    }
+}
+
+void PulseProcessor::__computeBurg(const double *data, int count, double period, double &frequency, double &snr)
+{
+    // counts are averaged down to about 10 Hz, pulse band is still below the Nyquist frequency
+    // and the model order is spent on the band of interest
+    int q = std::max(1, static_cast<int>(100.0 / period + 0.5));
+    int n = count / q;
+    period *= q;
+    int order = std::min(PULSE_PROCESSOR_BURG_ORDER, n / 3);
+    if(order < 2)
+        return;
+    v_burg.resize(3 * n + 2 * order);
+    double *x = &v_burg[0];
+    double *wk1 = x + n;
+    double *wk2 = wk1 + n;
+    double *wkm = wk2 + n;
+    double *d = wkm + order;
+    for(int j = 0; j < n; j++) {
+        x[j] = 0.0;
+        for(int i = 0; i < q; i++)
+            x[j] += data[j*q + i];
+        x[j] /= q;
+    }
+    // linear trend removal
+    double st = 0.0, sx = 0.0, stt = 0.0, stx = 0.0;
+    for(int j = 0; j < n; j++) {
+        st += j;
+        sx += x[j];
+        stt += (double)j*j;
+        stx += j*x[j];
+    }
+    double slope = (n*stx - st*sx) / (n*stt - st*st);
+    double offset = (sx - slope*st) / n;
+    for(int j = 0; j < n; j++)
+        x[j] -= offset + slope*j;
+
+    // Burg estimation of the autoregression coefficients, see Numerical Recipes memcof()
+    double xms = 0.0;
+    for(int j = 0; j < n; j++)
+        xms += x[j]*x[j];
+    xms /= n;
+    wk1[0] = x[0];
+    wk2[n - 2] = x[n - 1];
+    for(int j = 1; j < n - 1; j++) {
+        wk1[j] = x[j];
+        wk2[j - 1] = x[j];
+    }
+    for(int k = 0; k < order; k++) {
+        double num = 0.0, denom = 0.0;
+        for(int j = 0; j < n - k - 1; j++) {
+            num += wk1[j]*wk2[j];
+            denom += wk1[j]*wk1[j] + wk2[j]*wk2[j];
+        }
+        if(denom <= 0.0)
+            return;
+        d[k] = 2.0*num/denom;
+        xms *= (1.0 - d[k]*d[k]);
+        for(int i = 0; i < k; i++)
+            d[i] = wkm[i] - d[k]*wkm[k - 1 - i];
+        if(k == order - 1)
+            break;
+        for(int i = 0; i <= k; i++)
+            wkm[i] = d[i];
+        for(int j = 0; j < n - k - 2; j++) {
+            wk1[j] -= wkm[k]*wk2[j];
+            wk2[j] = wk2[j + 1] - wkm[k]*wk1[j + 1];
+        }
     }
-    if(m_snr > 2.0)
-        m_Frequency = (signal_moment / signal_power) * 60000.0 / time;
 
-    return m_Frequency;
+    // model spectrum is evaluated on the fine grid inside the frequency band only
+    double step = PULSE_PROCESSOR_BURG_STEP;
+    int points = static_cast<int>((m_topFrequencyLimit - m_bottomFrequencyLimit) / step) + 1;
+    v_burgpower.resize(points);
+    int i_maxpower = 0;
+    for(int i = 0; i < points; i++) {
+        double w = 2.0 * CV_PI * (m_bottomFrequencyLimit + i * step) * period / 1000.0;
+        double cw = std::cos(w), sw = std::sin(w);
+        double re = 1.0, im = 0.0, zr = 1.0, zi = 0.0;
+        for(int k = 0; k < order; k++) {
+            double tr = zr*cw + zi*sw; // z *= exp(-jw)
+            zi = zi*cw - zr*sw;
+            zr = tr;
+            re -= d[k]*zr;
+            im -= d[k]*zi;
+        }
+        v_burgpower[i] = xms / (re*re + im*im);
+        if(v_burgpower[i] > v_burgpower[i_maxpower])
+            i_maxpower = i;
+    }
+
+    int halfwidth = static_cast<int>(PULSE_PROCESSOR_BURG_PEAK / step);
+    double noise_power = 0.0, signal_power = 0.0, signal_moment = 0.0;
+    int signal_points = 0;
+    for(int i = 0; i < points; i++) {
+        if(std::abs(i - i_maxpower) <= halfwidth) {
+            signal_power += v_burgpower[i];
+            signal_moment += i * v_burgpower[i];
+            signal_points++;
+        } else {
+            noise_power += v_burgpower[i];
+        }
+    }
+    // model spectrum is smooth, so snr is taken as the ratio of power densities rather than of band sums,
+    // flat spectrum gives 0 dB
+    if(signal_power > 0.0 && noise_power > 0.0 && i_maxpower > 0 && i_maxpower < points - 1) {
+        snr = 10.0 * std::log10( (signal_power / signal_points) / (noise_power / (points - signal_points)) );
+        frequency = (m_bottomFrequencyLimit + step * signal_moment / signal_power) * 60.0;
+    }
+}
+
+void PulseProcessor::setFastLock(bool enabled)
+{
+    f_fastlock = enabled;
 }
 
 int PulseProcessor::getLength() const
@@ -194,9 +492,47 @@ const double * PulseProcessor::getSignal() const
     return v_Y;
 }
 
+int PulseProcessor::readSignal(double *dst, int size) const
+{
+    unsigned int seq;
+    int count;
+    do {
+        seq = __readBegin(m_signalseq);
+        int length = m_length;
+        int pos = curpos;
+        count = std::min(size, length);
+        for(int i = 0; i < count; i++)
+            dst[i] = v_Y[(pos - count + i + length) % length];
+    } while(__readRetry(m_signalseq, seq));
+    return count;
+}
+
+void PulseProcessor::readResult(double &frequency, double &snr) const
+{
+    unsigned int seq;
+    do {
+        seq = __readBegin(m_resultseq);
+        frequency = m_Frequency;
+        snr = m_snr;
+    } while(__readRetry(m_resultseq, seq));
+}
+
 double PulseProcessor::getSNR() const
 {
-    return m_snr;
+    double frequency, snr;
+    readResult(frequency, snr);
+    return snr;
+}
+
+bool PulseProcessor::isFrequencyFresh() const
+{
+    unsigned int seq;
+    bool fresh;
+    do {
+        seq = __readBegin(m_resultseq);
+        fresh = f_fresh;
+    } while(__readRetry(m_resultseq, seq));
+    return fresh;
 }
 
 double PulseProcessor::getSignalSampleValue() const
@@ -204,6 +540,37 @@ double PulseProcessor::getSignalSampleValue() const
     return v_Y[__loop(curpos-1)];
 }
 
+void PulseProcessor::setFrequencyLimits(double bottom_Hz, double top_Hz)
+{
+    m_bottomFrequencyLimit = bottom_Hz;
+    m_topFrequencyLimit = top_Hz;
+}
+
+void PulseProcessor::__writeBegin(std::atomic<unsigned int> &seq)
+{
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void PulseProcessor::__writeEnd(std::atomic<unsigned int> &seq)
+{
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+unsigned int PulseProcessor::__readBegin(const std::atomic<unsigned int> &seq)
+{
+    unsigned int value;
+    while((value = seq.load(std::memory_order_acquire)) & 1)
+        std::this_thread::yield();
+    return value;
+}
+
+bool PulseProcessor::__readRetry(const std::atomic<unsigned int> &seq, unsigned int value)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq.load(std::memory_order_relaxed) != value;
+}
+
 int PulseProcessor::__loop(int d) const
 {
     return ((m_length + (d % m_length)) % m_length);
@@ -216,6 +583,10 @@ int PulseProcessor::__seek(int d) const
 //--------------------------------FaceProcessor--------------------------------
 
 #define FACE_PROCESSOR_LENGTH 33
+#define FACE_PROCESSOR_PARALLEL_CUTOFF 65536 // smaller ROIs are processed by the calling thread
+#define FACE_PROCESSOR_TILE_PIXELS 16384
+#define FACE_PROCESSOR_CACHE_LINE 64
+#define FACE_PROCESSOR_MASK_SHIFT 2 // pixels, cached mask is rebuilt if the face rect moves further since the last rebuild
 
 FaceProcessor::FaceProcessor(const std::string &filename)
 {
@@ -228,14 +599,39 @@ FaceProcessor::FaceProcessor()
     __init();
 }
 
+FaceProcessor::FaceProcessor(const cv::Ptr<FaceDetectorModel> &model)
+{
+    __init();
+    setDetectorModel(model);
+}
+
 void FaceProcessor::__init()
 {
     v_rects = new cv::Rect[FACE_PROCESSOR_LENGTH];
+    p_pool = 0;
+    m_samplingTarget = 0;
+    m_stride = 1;
+    f_maskreuse = false;
+    m_maskperiod = 8;
+    m_maskphase = 0;
+    m_maskstride = 1;
+    m_minFaceSize = cv::Size(100,120);
+    m_blurSize = cv::Size(3,3);
+    reset();
+}
+
+void FaceProcessor::reset()
+{
+    for(int i = 0; i < FACE_PROCESSOR_LENGTH; i++)
+        v_rects[i] = cv::Rect(0,0,0,0);
     m_pos = 0;
     m_nofaceframes = 0;
     f_firstface = true;
-    m_minFaceSize = cv::Size(100,120);
-    m_blurSize = cv::Size(3,3);
+    m_faceRect = cv::Rect(0,0,0,0);
+    m_fixedRect = cv::Rect(0,0,0,0); // instance could be reused for other subject, e.g. from the FaceProcessorPool
+    m_mask.release();
+    f_maskstale = true;
+    m_markTime = cv::getTickCount();
 }
 
 FaceProcessor::~FaceProcessor()
@@ -243,17 +639,212 @@ FaceProcessor::~FaceProcessor()
     delete[] v_rects;
 }
 
+template<typename Sink>
+void FaceProcessor::__visitRows(const cv::Mat &region, int begin, int end, const Sink &sink)
+{
+    // rows of the sampling grid in [begin, end), skin pixels inside the ellipse are passed to the sink,
+    // classification is taken from the cached mask for the rows that are not refreshed on this frame
+    int X = m_ellRect.x;
+    int W = m_ellRect.width;
+    int S = m_stride;
+    for(int j = (begin + S - 1) / S * S; j < end; j += S) {
+        unsigned char *mask = f_maskreuse ? m_mask.ptr(j) : 0;
+        bool refresh = __refreshRow(j);
+        for(int i = X; i < X + W; i += S) {
+            if(!refresh && mask[i] == 0)
+                continue;
+            unsigned char tB, tG, tR;
+            __readPixel(region, i, j, tB, tG, tR);
+            if(refresh) {
+                bool inside = __skinColor(tR, tG, tB) && __insideEllipse(i, j);
+                if(mask)
+                    mask[i] = inside;
+                if(!inside)
+                    continue;
+            }
+            sink(i, j, tB, tG, tR);
+        }
+    }
+}
+
 void FaceProcessor::enrollImage(const cv::Mat &rgbImage, double &resV, double &resT)
+{
+    unsigned long green = 0;
+    unsigned long area = 0;
+
+    cv::Mat region;
+    if(__prepareRegion(rgbImage, region)) {
+        int H = region.rows;
+        if(__parallel(H)) {
+            // each thread sums its tiles into its own cache line, no fork/join of threads per frame
+            RowsPartial *partials = reinterpret_cast<RowsPartial *>(__partials(sizeof(RowsPartial)));
+            p_pool->parallelFor(0, H, __tileRows(), [&](int begin, int end, unsigned int thread) {
+                __enrollRows(region, begin, end, partials[thread].area, partials[thread].green);
+            });
+            for(unsigned int t = 0; t < p_pool->getThreadsCount(); t++) {
+                area += partials[t].area;
+                green += partials[t].green;
+            }
+        } else {
+            #pragma omp parallel for reduction(+:area,green)
+            for(int j = 0; j < H; j += m_stride)
+                __enrollRows(region, j, j + 1, area, green);
+        }
+    }
+
+    resT = __updateTimer();
+    // each grid node stands for m_stride x m_stride pixels
+    if(area * m_stride * m_stride > static_cast<unsigned long>(m_minFaceSize.area()/2)) {
+        resV = (double)green / area;
+    } else {
+        resV = 0.0;
+    }
+}
+
+void FaceProcessor::enrollImage(const cv::Mat &rgbImage, RoiAccumulator &accumulator, double &resT)
+{
+    accumulator.clear();
+
+    cv::Mat region;
+    if(__prepareRegion(rgbImage, region)) {
+        accumulator.__prepare(region.size());
+        int H = region.rows;
+        const uchar *rowlabels = accumulator.v_rowLabels.data();
+        const uchar *collabels = accumulator.v_colLabels.data();
+        auto accumulateRows = [&](int begin, int end, RoiAccumulator::Sums *sums) {
+            __visitRows(region, begin, end, [&](int i, int j, unsigned char vB, unsigned char vG, unsigned char vR) {
+                RoiAccumulator::__add(sums, rowlabels[j] & collabels[i], vB, vG, vR);
+            });
+        };
+        if(__parallel(H)) {
+            // region sums occupy whole number of cache lines, so threads do not share them
+            RoiAccumulator::Sums *partials = reinterpret_cast<RoiAccumulator::Sums *>(__partials(sizeof(RoiAccumulator::Sums) * RoiAccumulator::maxRegions));
+            p_pool->parallelFor(0, H, __tileRows(), [&](int begin, int end, unsigned int thread) {
+                accumulateRows(begin, end, partials + thread * RoiAccumulator::maxRegions);
+            });
+            for(unsigned int t = 0; t < p_pool->getThreadsCount(); t++)
+                accumulator.__merge(partials + t * RoiAccumulator::maxRegions);
+        } else {
+            accumulateRows(0, H, accumulator.v_sums);
+        }
+    }
+
+    resT = __updateTimer();
+}
+
+void FaceProcessor::__enrollRows(const cv::Mat &region, int begin, int end, unsigned long &area, unsigned long &green)
+{
+    __visitRows(region, begin, end, [&](int, int, unsigned char, unsigned char vG, unsigned char) {
+        area++;
+        green += vG;
+    });
+}
+
+bool FaceProcessor::__refreshRow(int j) const
+{
+    return !f_maskreuse || f_maskfull || (j / m_stride) % m_maskperiod == m_maskphase;
+}
+
+void FaceProcessor::__updateMask(const cv::Size &size)
+{
+    if(!f_maskreuse)
+        return;
+    // ellipse is bound to the region, so the cached mask stays valid while the mean rect is shifted by few pixels,
+    // skin pixels displaced by the shift are corrected by the rotating rows refresh
+    cv::Point shift = m_faceRect.tl() - m_maskorigin;
+    f_maskfull = f_maskstale || m_mask.size() != size || m_maskstride != m_stride
+                 || std::abs(shift.x) > FACE_PROCESSOR_MASK_SHIFT || std::abs(shift.y) > FACE_PROCESSOR_MASK_SHIFT;
+    if(f_maskfull) {
+        m_mask = cv::Mat::zeros(size, CV_8UC1);
+        m_maskstride = m_stride;
+        m_maskorigin = m_faceRect.tl();
+        m_maskphase = 0;
+        f_maskstale = false;
+    } else {
+        m_maskphase = (m_maskphase + 1) % m_maskperiod;
+    }
+}
+
+void FaceProcessor::__readPixel(const cv::Mat &region, int i, int j, unsigned char &vB, unsigned char &vG, unsigned char &vR) const
+{
+    if(m_stride == 1) { // region is blurred already
+        const unsigned char *ptr = region.ptr(j) + 3*i;
+        vB = ptr[0];
+        vG = ptr[1];
+        vR = ptr[2];
+    } else { // 3x3 mean at the grid node, neighbours are clamped to the region
+        int sB = 0, sG = 0, sR = 0, n = 0;
+        for(int y = std::max(j - 1, 0); y <= std::min(j + 1, region.rows - 1); y++) {
+            const unsigned char *ptr = region.ptr(y);
+            for(int x = std::max(i - 1, 0); x <= std::min(i + 1, region.cols - 1); x++) {
+                sB += ptr[3*x];
+                sG += ptr[3*x+1];
+                sR += ptr[3*x+2];
+                n++;
+            }
+        }
+        vB = static_cast<unsigned char>((sB + n/2) / n); // rounded as cv::blur does
+        vG = static_cast<unsigned char>((sG + n/2) / n);
+        vR = static_cast<unsigned char>((sR + n/2) / n);
+    }
+}
+
+bool FaceProcessor::__parallel(int rows) const
+{
+    return p_pool != 0 && (rows / m_stride) * (m_ellRect.width / m_stride) >= FACE_PROCESSOR_PARALLEL_CUTOFF;
+}
+
+int FaceProcessor::__tileRows() const
+{
+    // whole number of grid rows with about FACE_PROCESSOR_TILE_PIXELS nodes
+    int nodes = std::max(1, m_ellRect.width / m_stride);
+    return std::max(1, FACE_PROCESSOR_TILE_PIXELS / nodes) * m_stride;
+}
+
+unsigned char *FaceProcessor::__partials(size_t size)
+{
+    // one zeroed slot per thread, slots start at cache line boundaries
+    size = (size + FACE_PROCESSOR_CACHE_LINE - 1) / FACE_PROCESSOR_CACHE_LINE * FACE_PROCESSOR_CACHE_LINE;
+    v_partials.assign(size * p_pool->getThreadsCount() + FACE_PROCESSOR_CACHE_LINE, 0);
+    size_t address = reinterpret_cast<size_t>(v_partials.data());
+    return v_partials.data() + (FACE_PROCESSOR_CACHE_LINE - address % FACE_PROCESSOR_CACHE_LINE) % FACE_PROCESSOR_CACHE_LINE;
+}
+
+void FaceProcessor::setThreadPool(ThreadPool *pool)
+{
+    p_pool = pool;
+}
+
+void FaceProcessor::setFaceRect(const cv::Rect &rect)
+{
+    if((rect.area() > 0) != (m_fixedRect.area() > 0))
+        f_maskstale = true; // switch between the detection and the given rect
+    m_fixedRect = rect;
+}
+
+void FaceProcessor::setSamplingTarget(int samples)
+{
+    m_samplingTarget = std::max(samples, 0);
+}
+
+void FaceProcessor::setMaskReuse(bool enabled, int refreshPeriod)
+{
+    f_maskreuse = enabled;
+    m_maskperiod = std::max(refreshPeriod, 1);
+    m_mask.release();
+}
+
+void FaceProcessor::__detectFace(const cv::Mat &rgbImage)
 {
     cv::Mat img;
     double scaleX = 1.0, scaleY = 1.0;
     if(rgbImage.cols > 640 || rgbImage.rows > 480) {
         if( ((float)rgbImage.cols/rgbImage.rows) > 14.0/9.0 ) {
-            cv::resize(rgbImage, img, cv::Size(640, 360), 0.0, 0.0, CV_INTER_AREA);
+            cv::resize(rgbImage, img, cv::Size(640, 360), 0.0, 0.0, cv::INTER_AREA);
             scaleX = (double)rgbImage.cols / 640.0;
             scaleY = (double)rgbImage.rows / 360.0;
         } else {
-            cv::resize(rgbImage, img, cv::Size(640, 480), 0.0, 0.0, CV_INTER_AREA);
+            cv::resize(rgbImage, img, cv::Size(640, 480), 0.0, 0.0, cv::INTER_AREA);
             scaleX = (double)rgbImage.cols / 640.0;
             scaleY = (double)rgbImage.rows / 480.0;
         }
@@ -261,9 +852,12 @@ void FaceProcessor::enrollImage(const cv::Mat &rgbImage, double &resV, double &r
         img = rgbImage;
 
     std::vector<cv::Rect> faces;
-    m_classifier.detectMultiScale(img, faces, 1.15, 5, cv::CASCADE_FIND_BIGGEST_OBJECT, m_minFaceSize);
+    cv::CascadeClassifier &classifier = m_model ? m_model->getThreadClassifier() : m_classifier;
+    classifier.detectMultiScale(img, faces, 1.15, 5, cv::CASCADE_FIND_BIGGEST_OBJECT, m_minFaceSize);
 
     if(faces.size() > 0) {
+        if(f_firstface)
+            f_maskstale = true; // tracking is re-armed, cached mask could belong to other face
         __updateRects(faces[0]);
         m_nofaceframes = 0;
         f_firstface = false;
@@ -271,6 +865,7 @@ void FaceProcessor::enrollImage(const cv::Mat &rgbImage, double &resV, double &r
         m_nofaceframes++;
         if(m_nofaceframes == FACE_PROCESSOR_LENGTH) {
             f_firstface = true;
+            f_maskstale = true;
             __updateRects(cv::Rect(0,0,0,0));
         }
     }
@@ -278,45 +873,44 @@ void FaceProcessor::enrollImage(const cv::Mat &rgbImage, double &resV, double &r
     cv::Rect tempRect = __getMeanRect();
     m_faceRect = cv::Rect((int)(tempRect.x*scaleX), (int)(tempRect.y*scaleY), (int)(tempRect.width*scaleX), (int)(tempRect.height*scaleY))
                  & cv::Rect(0, 0, rgbImage.cols, rgbImage.rows);
+}
 
-    int W = m_faceRect.width;
-    int H = m_faceRect.height;
-    unsigned long green = 0;
-    unsigned long area = 0;
+bool FaceProcessor::__prepareRegion(const cv::Mat &rgbImage, cv::Mat &region)
+{
+    if(m_fixedRect.area() > 0) {
+        m_faceRect = m_fixedRect & cv::Rect(0, 0, rgbImage.cols, rgbImage.rows);
+        m_nofaceframes = 0;
+    } else {
+        __detectFace(rgbImage);
+    }
 
     if(m_faceRect.area() > 0 && m_nofaceframes < FACE_PROCESSOR_LENGTH) {
-        cv::Mat region = cv::Mat(rgbImage, m_faceRect).clone();
-        cv::blur(region,region, m_blurSize);
+        m_stride = 1;
+        if(m_samplingTarget > 0)
+            m_stride = std::max(1, static_cast<int>(std::sqrt((double)m_faceRect.area() / m_samplingTarget)));
+        if(m_stride == 1) {
+            region = cv::Mat(rgbImage, m_faceRect).clone();
+            cv::blur(region,region, m_blurSize);
+        } else { // grid nodes are smoothed on the fly, see __readPixel()
+            region = cv::Mat(rgbImage, m_faceRect);
+        }
+        int W = m_faceRect.width;
+        int H = m_faceRect.height;
         int dX = W / 16;
         int dY = H / 30;
         // It will be rect inside m_faceRect
         m_ellRect = cv::Rect(dX, -6 * dY, W - 2 * dX, H + 6 * dY);
-        int X = m_ellRect.x;
-        W = m_ellRect.width;
-        unsigned char *ptr;
-        unsigned char tR = 0, tG = 0, tB = 0;
-        #pragma omp parallel for private(ptr,tB,tG,tR) reduction(+:area,green)
-        for(int j = 0; j < H; j++) {
-            ptr = region.ptr(j);
-            for(int i = X; i < X + W; i++) {
-                tB = ptr[3*i];
-                tG = ptr[3*i+1];
-                tR = ptr[3*i+2];
-                if( __skinColor(tR, tG, tB) && __insideEllipse(i, j)) {
-                    area++;
-                    green += tG;
-                }
-            }
-        }
+        __updateMask(region.size());
+        return true;
     }
+    return false;
+}
 
-    resT = ((double)cv::getTickCount() -  (double)m_markTime)*1000.0 / cv::getTickFrequency();
+double FaceProcessor::__updateTimer()
+{
+    double time = ((double)cv::getTickCount() -  (double)m_markTime)*1000.0 / cv::getTickFrequency();
     m_markTime = cv::getTickCount();
-    if(area > static_cast<unsigned long>(m_minFaceSize.area()/2)) {
-        resV = (double)green / area;
-    } else {
-        resV = 0.0;
-    }
+    return time;
 }
 
 cv::Rect FaceProcessor::__getMeanRect() const
@@ -338,9 +932,21 @@ cv::Rect FaceProcessor::__getMeanRect() const
 
 bool FaceProcessor::loadClassifier(const std::string &filename)
 {
+    m_model.release();
     return m_classifier.load(filename);
 }
 
+void FaceProcessor::setDetectorModel(const cv::Ptr<FaceDetectorModel> &model)
+{
+    m_model = model;
+}
+
+void FaceProcessor::releaseThreadClassifier()
+{
+    if(m_model)
+        m_model->releaseThreadClassifier();
+}
+
 double FaceProcessor::measureFramePeriod(cv::VideoCapture *_vcptr)
 {
     //Check if video source is opened
@@ -374,6 +980,8 @@ void FaceProcessor::dropTimer()
 
 bool FaceProcessor::empty()
 {
+    if(m_model)
+        return m_model->empty();
     return m_classifier.empty();
 }
 
@@ -36,19 +36,31 @@
 #include "opencv2/videoio.hpp"
 #include "opencv2/imgproc.hpp"
 
-#ifdef DLL_BUILD_SETUP
-    #define DLLSPEC __declspec(dllexport)
-#else
-    #define DLLSPEC __declspec(dllimport)
+#include <atomic>
+
+#if defined(_WIN32)
+    #ifdef DLL_BUILD_SETUP
+        #define DLLSPEC __declspec(dllexport)
+    #else
+        #define DLLSPEC __declspec(dllimport)
+    #endif
+#else // shared object is built with hidden visibility, only the library classes are exported
+    #define DLLSPEC __attribute__((visibility("default")))
 #endif
 
 /**
  * vpg namespace represents classes for ppg signal from video processing
  */
 namespace vpg {
+
+class RoiAccumulator;
+class FaceDetectorModel;
+class ThreadPool;
 //-------------------------------------------------------
 /**
  * The PulseProcessor class process ppg signal to measure pulse rate
+ * @note update() could be called from one thread while computeFrequency() is called from another one,
+ * other threads could use readSignal() and readResult() at the same time, readers never block the writer
  */
 class DLLSPEC PulseProcessor
 {
@@ -56,15 +68,17 @@ public:
     enum ProcessType {HeartRate};
     /**
      * Default constructor
-     * @param dT_ms - discretization period in milliseconds
+     * @param dT_ms - discretization period in milliseconds, pass non positive value to estimate it from update() times
      * @param type - type of desired pulse frequency source/range
+     * @note estimated period is limited by Tcn_ms/2 and Tlpf_ms (200 ms with the defaults), so the windows are never empty
      */
     PulseProcessor(double dT_ms = 33.0, ProcessType type = HeartRate);
     /**
      * Overloaded constructor
      * @param Tov_ms - length of signal record in time domain in milliseconds
      * @param Tcn_ms - time interval for signal centering and normalization
-     * @param dT_ms - discretization period in milliseconds
+     * @param Tlpf_ms - time interval for signal low pass filtration
+     * @param dT_ms - discretization period in milliseconds, pass non positive value to estimate it from update() times
      * @param type - type of desired pulse frequency source/range
      */
     PulseProcessor(double Tov_ms, double Tcn_ms, double Tlpf_ms,  double dT_ms, ProcessType type);
@@ -72,6 +86,21 @@ public:
      * Class destructor
      */
     virtual ~PulseProcessor();
+    /**
+     * Change windows and period, storage is reused when its capacity is enough
+     * @param Tov_ms - length of signal record in time domain in milliseconds
+     * @param Tcn_ms - time interval for signal centering and normalization
+     * @param Tlpf_ms - time interval for signal low pass filtration
+     * @param dT_ms - discretization period in milliseconds, pass non positive value to estimate it from update() times
+     * @param type - type of desired pulse frequency source/range
+     * @note frequency limits are set to the defaults of the type, signal is reset,
+     * should not be called concurrently with the readers
+     */
+    void reconfigure(double Tov_ms, double Tcn_ms, double Tlpf_ms, double dT_ms, ProcessType type = HeartRate);
+    /**
+     * Drop signal and results, configuration is kept
+     */
+    void reset();
     /**
      * Update ppg signal by one count
      * @param value - count value
@@ -87,8 +116,15 @@ public:
     /**
      * Get signal length
      * @return signal length
+     * @note could change after update() when frame period is estimated online
      */
     int getLength() const;
+    /**
+     * @brief get discretization period
+     * @return period in milliseconds, it is the current estimation if period was not set in constructor
+     * @note when estimation settles, windows are rescaled in place and the newest counts are kept
+     */
+    double getFramePeriod() const;
     /**
      * @brief self explained
      * @return current position in the signal vector
@@ -97,21 +133,61 @@ public:
     /**
      * @brief get pointer to signal counts
      * @return pointer to data
+     * @note points to the live ring buffer, use readSignal() if update() is called from another thread
      */
     const double *getSignal() const;
+    /**
+     * @brief copy consistent snapshot of the signal, safe to call concurrently with update()
+     * @param dst - destination, the newest counts are written from the oldest to the newest
+     * @param size - capacity of the destination
+     * @return number of counts written
+     */
+    int readSignal(double *dst, int size) const;
+    /**
+     * @brief read consistent pair of the last results, safe to call concurrently with computeFrequency()
+     * @param frequency - where heart rate in bpm should be written
+     * @param snr - where snr in dB should be written
+     */
+    void readResult(double &frequency, double &snr) const;
     /**
      * @brief get snr value
      * @return relation between pulse and noise harmonics energies
      */
     double getSNR() const;
+    /**
+     * @brief tell whether the last computeFrequency() result is a new estimation
+     * @return false if snr was below the threshold and computeFrequency() returned the previous result
+     */
+    bool isFrequencyFresh() const;
     /**
      * @brief use this function to get last one VPG signal sample value
      * @return value of the centered and normalized VPG signal
      */
     double getSignalSampleValue() const;
+    /**
+     * @brief set frequency band where pulse harmonic is searched
+     * @param bottom_Hz - bottom limit in Hz
+     * @param top_Hz - top limit in Hz
+     */
+    void setFrequencyLimits(double bottom_Hz, double top_Hz);
+    /**
+     * @brief enable fast lock mode, until the signal window is filled, computeFrequency() uses
+     * autoregression (Burg) spectrum of the available counts, so the first results are available after 3 s
+     * @param enabled - self explained, disabled by default
+     * @note snr of the autoregression spectrum is the power density ratio, it is higher than the periodogram one and has its own threshold
+     */
+    void setFastLock(bool enabled);
 
 private:
 
+    void __computePeriodogram(int length, double time, double &frequency, double &snr);
+    void __computeBurg(const double *data, int count, double period, double &frequency, double &snr);
+    void __estimatePeriod(double time);
+    void __rescale(double dT_ms);
+    static void __writeBegin(std::atomic<unsigned int> &seq);
+    static void __writeEnd(std::atomic<unsigned int> &seq);
+    static unsigned int __readBegin(const std::atomic<unsigned int> &seq);
+    static bool __readRetry(const std::atomic<unsigned int> &seq, unsigned int value);
     int __loop(int d) const;
     int __seek(int d) const;
     void __init(double Tov_ms, double Tcn_ms, double Tlpf_ms, double dT_ms, ProcessType type);
@@ -124,15 +200,32 @@ private:
     int m_interval;
     int m_length;
     int m_filterlength;
+    int m_capacity;
+    int m_filtercapacity;
     int curpos;
+    int m_count;
     double m_bottomFrequencyLimit;
     double m_topFrequencyLimit;    
     double m_snr;
     double m_Frequency;
+    bool f_fresh;
     double m_dTms;
+    double m_Tovms;
+    double m_Tcnms;
+    double m_Tlpfms;
+    bool f_autoperiod;
+    static const int periodBlock = 30; // counts per frame period estimation
+    double v_periods[periodBlock];
+    int m_periodcount;
+    bool f_fastlock;
+    std::vector<double> v_burg;
+    std::vector<double> v_burgpower;
 
     cv::Mat v_datamat;
     cv::Mat v_dftmat;
+
+    std::atomic<unsigned int> m_signalseq; // seqlock counters, odd value means write in progress
+    std::atomic<unsigned int> m_resultseq;
 };
 //-------------------------------------------------------
 /**
@@ -150,6 +243,11 @@ public:
      * @param filename - name of file for cv::CascadeClassifier class
      */
     FaceProcessor(const std::string &filename);
+    /**
+     * Overloaded class constructor
+     * @param model - detector model shared with other instances (see FaceDetectorModel)
+     */
+    FaceProcessor(const cv::Ptr<FaceDetectorModel> &model);
 
     /**
      * Class destructor
@@ -162,6 +260,13 @@ public:
      * @param resT - where processing time should be written
      */
     void enrollImage(const cv::Mat &rgbImage, double &resV, double &resT);
+    /**
+     * Overloaded function, collects per channel statistics of all regions of the accumulator in one pass
+     * @param rgb - input image, BGR format only
+     * @param accumulator - where result statistics should be written (see RoiAccumulator)
+     * @param resT - where processing time should be written
+     */
+    void enrollImage(const cv::Mat &rgbImage, RoiAccumulator &accumulator, double &resT);
     /**
      * Get cv::Rect that bounds face on image
      * @return coordinates of face on image in cv::Rect form
@@ -171,15 +276,59 @@ public:
      * Load cv::CascadeClassifier face pattern from a file
      * @param filename - name of file for cv::CascadeClassifier class
      * @return was file loaded or not
+     * @note shared detector model is detached
      */
     bool loadClassifier(const std::string &filename);
     /**
-     * @brief measureFramePeriod should be used to measure frame period for the target video source
+     * Use shared detector model instead of own classifier
+     * @param model - detector model shared with other instances, pass empty pointer to use own classifier again
+     */
+    void setDetectorModel(const cv::Ptr<FaceDetectorModel> &model);
+    /**
+     * Return classifier of the calling thread to the shared detector model (see FaceDetectorModel::releaseThreadClassifier()),
+     * call it before the thread that has run enrollImage() exits, it does nothing when the own classifier is used
+     */
+    void releaseThreadClassifier();
+    /**
+     * @brief measureFramePeriod could be used to measure frame period for the target video source
+     * @note it is not needed when PulseProcessor is constructed with non positive dT_ms
      * @param _vcptr - pointe rto the target video capture (that will be used to VPG extraction)
      * @return average frame time in ms (use this value to instantiate PulseProcessor instance then)
      * @note VideoCapture object should be opened else -1.0 will be returned
      */
     double measureFramePeriod(cv::VideoCapture *_vcptr);
+    /**
+     * Use persistent threads for the ROI processing
+     * @param pool - pool that could be shared with other instances, pass 0 to process ROI by the calling thread (or by OpenMP if enabled)
+     * @note small ROIs are always processed by the calling thread, the pool is not owned
+     */
+    void setThreadPool(ThreadPool *pool);
+    /**
+     * @brief setFaceRect - use the given face rect instead of the detection, e.g. when the face is tracked by the caller
+     * @param rect - face rect in the image coordinates, pass empty rect to detect face again
+     * @note the rect is dropped by reset()
+     */
+    void setFaceRect(const cv::Rect &rect);
+    /**
+     * @brief setSamplingTarget - limit the number of the ROI pixels visited per frame, large faces are sampled on the regular grid
+     * with 3x3 mean at each node instead of whole ROI blur, so the ROI processing cost does not depend on the face size
+     * @param samples - approximate number of the grid nodes per frame, pass 0 to visit all pixels (default)
+     * @note sensor noise variance of the count grows approximately as N / (9 * samples), where N is the face rect area,
+     * no effect when the face rect area is smaller than samples, 10000 samples keep the difference negligible for most of the cameras
+     */
+    void setSamplingTarget(int samples);
+    /**
+     * @brief setMaskReuse - cache skin and ellipse classification of the ROI pixels between frames, while the face rect size does not change
+     * and the rect is shifted by few pixels only, each frame reclassifies only every refreshPeriod-th row, rows are rotated, so whole mask is revalidated
+     * in refreshPeriod frames, whole mask is rebuilt also when the face is lost or detected again
+     * @param enabled - self explained, disabled by default
+     * @param refreshPeriod - number of frames to revalidate whole mask
+     */
+    void setMaskReuse(bool enabled, int refreshPeriod=8);
+    /**
+     * @brief reset - drop face tracking history, the rect given by setFaceRect() and the internal timer, loaded classifier is kept
+     */
+    void reset();
     /**
      * @brief dropTimer - call to drop the internal timer
      */
@@ -192,6 +341,7 @@ public:
 
 private:
     cv::CascadeClassifier m_classifier;
+    cv::Ptr<FaceDetectorModel> m_model;
     cv::Rect *v_rects;
     cv::Rect m_ellRect;
     int64 m_markTime;
@@ -199,9 +349,39 @@ private:
     uchar m_nofaceframes;
     bool f_firstface;
     cv::Rect m_faceRect;
+    cv::Rect m_fixedRect;
     cv::Size m_minFaceSize;
     cv::Size m_blurSize;
+    ThreadPool *p_pool;
+    std::vector<unsigned char> v_partials;
+    int m_samplingTarget;
+    int m_stride;
+    cv::Mat m_mask;
+    bool f_maskreuse;
+    bool f_maskfull;
+    bool f_maskstale;
+    cv::Point m_maskorigin;
+    int m_maskperiod;
+    int m_maskphase;
+    int m_maskstride;
+
+    struct RowsPartial {
+        unsigned long area;
+        unsigned long green;
+    };
 
+    bool __prepareRegion(const cv::Mat &rgbImage, cv::Mat &region);
+    void __detectFace(const cv::Mat &rgbImage);
+    double __updateTimer();
+    template<typename Sink>
+    void __visitRows(const cv::Mat &region, int begin, int end, const Sink &sink);
+    void __enrollRows(const cv::Mat &region, int begin, int end, unsigned long &area, unsigned long &green);
+    inline bool __refreshRow(int j) const;
+    void __updateMask(const cv::Size &size);
+    inline void __readPixel(const cv::Mat &region, int i, int j, unsigned char &vB, unsigned char &vG, unsigned char &vR) const;
+    bool __parallel(int rows) const;
+    int __tileRows() const;
+    unsigned char *__partials(size_t size);
     cv::Rect __getMeanRect() const;
     void __updateRects(const cv::Rect &rect);
     bool __insideEllipse(int x, int y) const;
@@ -6,13 +6,37 @@ CONFIG(release, debug|release) {
     TARGET = vpgd
 }
 
-SOURCES += vpg.cpp
-
-HEADERS += vpg.h
+CONFIG += c++11
+
+SOURCES += vpg.cpp \
+           signalrecorder.cpp \
+           signalreplay.cpp \
+           parametersweep.cpp \
+           roiaccumulator.cpp \
+           facedetectormodel.cpp \
+           threadpool.cpp \
+           pipeline.cpp
+
+HEADERS += vpg.h \
+           signalrecorder.h \
+           signalreplay.h \
+           parametersweep.h \
+           roiaccumulator.h \
+           objectpool.h \
+           facedetectormodel.h \
+           threadpool.h \
+           boundedqueue.h \
+           pipeline.h
 
 include(opencv.pri)
 include(openmp.pri)
 include(opencl.pri)
+include(optimization.pri)
+
+unix {
+    QMAKE_CXXFLAGS += -fvisibility=hidden -fvisibility-inlines-hidden
+    LIBS += -pthread
+}
 
 #---------------------------------------------------------
 DEFINES += DLL_BUILD_SETUP # is defined only if library build (for dll generation)
@@ -23,8 +47,11 @@ win32-msvc2012: COMPILER = vc11
 win32-msvc2013: COMPILER = vc12
 win32-msvc2015: COMPILER = vc14
 win32-g++:      COMPILER = mingw
+unix:           COMPILER = $$basename(QMAKE_CXX)
 win32:contains(QMAKE_TARGET.arch, x86_64){
     ARCHITECTURE = x64
+} else:unix {
+    ARCHITECTURE = $${QMAKE_HOST.arch}
 } else {
     ARCHITECTURE = x86
 }
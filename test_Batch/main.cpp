@@ -0,0 +1,199 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "vpg.h"
+#include "facedetectormodel.h"
+#include "signalrecorder.h"
+
+struct FileSummary {
+    std::string fileName;
+    bool opened;
+    unsigned long frames;
+    double duration_s;
+    double meanHR;
+    double meanSNR;
+    unsigned long measurements;
+    double fps; // processing speed
+};
+
+static std::string baseName(const std::string &path)
+{
+    size_t pos = path.find_last_of("/\\");
+    return pos == std::string::npos ? path : path.substr(pos + 1);
+}
+
+static void processFile(const std::string &fileName, const cv::Ptr<vpg::FaceDetectorModel> &model,
+                        const std::string &outputDir, FileSummary &summary)
+{
+    summary.fileName = fileName;
+    summary.opened = false;
+    summary.frames = 0;
+    summary.duration_s = 0.0;
+    summary.meanHR = 0.0;
+    summary.meanSNR = 0.0;
+    summary.measurements = 0;
+    summary.fps = 0.0;
+
+    cv::VideoCapture capture;
+    if(!capture.open(fileName))
+        return;
+    summary.opened = true;
+
+    double framePeriod = 1000.0 / capture.get(cv::CAP_PROP_FPS); // milliseconds
+    if(!(framePeriod > 0.0 && framePeriod < 1000.0))
+        framePeriod = 33.0; // video time is used, processing is not real time
+    vpg::FaceProcessor faceproc(model);
+    vpg::PulseProcessor pulseproc(framePeriod);
+
+    vpg::SignalRecorder recorder;
+    if(!outputDir.empty())
+        recorder.open(outputDir + "/" + baseName(fileName) + ".vpgr");
+
+    cv::Mat frame;
+    double s = 0.0, t = 0.0, timeout = 1000.0, frequency = -1.0, snr = 0.0;
+    int64 ticks = cv::getTickCount();
+    while(capture.read(frame)) {
+        faceproc.enrollImage(frame, s, t);
+        pulseproc.update(s, framePeriod);
+        timeout -= framePeriod;
+        if(timeout < 0.0) {
+            frequency = pulseproc.computeFrequency();
+            snr = pulseproc.getSNR();
+            if(frequency > 0.0) {
+                summary.meanHR += frequency;
+                summary.meanSNR += snr;
+                summary.measurements++;
+            }
+            timeout = 1000.0;
+        }
+        if(recorder.isOpened())
+            recorder.write(summary.frames, (summary.frames + 1) * framePeriod, s, pulseproc.getSignalSampleValue(), frequency, snr, faceproc.getFaceRect());
+        summary.frames++;
+    }
+    double elapsed = (cv::getTickCount() - ticks) / cv::getTickFrequency();
+
+    summary.duration_s = summary.frames * framePeriod / 1000.0;
+    if(summary.measurements > 0) {
+        summary.meanHR /= summary.measurements;
+        summary.meanSNR /= summary.measurements;
+    }
+    summary.fps = elapsed > 0.0 ? summary.frames / elapsed : 0.0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string inputDir;
+    std::string listFileName;
+    std::string extension = "avi";
+    std::string outputDir;
+    std::string cascadeFileName = std::string(OPENCV_DATA_DIR) + std::string("/haarcascades/haarcascade_frontalface_alt.xml");
+    unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    while( (--argc > 0) && ((*++argv)[0] == '-') ) {
+        char option = *++argv[0];
+        switch (option) {
+            case 'i':
+                inputDir = ++(*argv);
+                break;
+            case 'l':
+                listFileName = ++(*argv);
+                break;
+            case 'e':
+                extension = ++(*argv);
+                break;
+            case 'o':
+                outputDir = ++(*argv);
+                break;
+            case 'c':
+                cascadeFileName = ++(*argv);
+                break;
+            case 'j':
+                jobs = std::max(1, std::atoi(++(*argv)));
+                break;
+            case 'h':
+                std::printf("test_Batch\n"
+                            "Options:\n"
+                            " -i[dirname] - input directory\n"
+                            " -e[ext] - extension of the video files in the input directory (default avi)\n"
+                            " -l[filename] - text file with the list of video files, one per line\n"
+                            " -o[dirname] - output directory for the binary records and summary\n"
+                            " -c[filename] - cascade classifier file\n"
+                            " -j[int] - number of files processed in parallel (default is number of cores)\n"
+                            " -h - this help ;)\n");
+                return 0;
+        }
+    }
+
+    std::vector<std::string> files;
+    if(!inputDir.empty()) {
+        std::vector<cv::String> found;
+        cv::glob(inputDir + "/*." + extension, found, false);
+        files.assign(found.begin(), found.end());
+    }
+    if(!listFileName.empty()) {
+        std::ifstream list(listFileName.c_str());
+        std::string line;
+        while(std::getline(list, line))
+            if(!line.empty())
+                files.push_back(line);
+    }
+    if(files.empty()) {
+        std::printf("There are no input files, use -h for help\n");
+        return -1;
+    }
+
+    jobs = std::min<unsigned int>(jobs, static_cast<unsigned int>(files.size()));
+    // model is parsed once, each worker thread gets its own classifier
+    cv::Ptr<vpg::FaceDetectorModel> model = cv::makePtr<vpg::FaceDetectorModel>(cascadeFileName, jobs);
+    if(model->empty()) {
+        std::printf("Can not load cascade %s\n", cascadeFileName.data());
+        return -1;
+    }
+    if(jobs > 1)
+        cv::setNumThreads(1); // parallelism comes from the files, do not oversubscribe cores
+
+    std::vector<FileSummary> summaries(files.size());
+    std::atomic<size_t> next(0);
+    int64 ticks = cv::getTickCount();
+    std::vector<std::thread> workers;
+    for(unsigned int j = 0; j < jobs; j++)
+        workers.push_back(std::thread([&]() {
+            size_t i;
+            while((i = next.fetch_add(1)) < files.size()) {
+                processFile(files[i], model, outputDir, summaries[i]);
+                std::printf("%s: %lu frames, %.1f fps\n", files[i].data(), summaries[i].frames, summaries[i].fps);
+            }
+            model->releaseThreadClassifier();
+        }));
+    for(size_t j = 0; j < workers.size(); j++)
+        workers[j].join();
+    double elapsed = (cv::getTickCount() - ticks) / cv::getTickFrequency();
+
+    unsigned long totalFrames = 0;
+    for(size_t i = 0; i < summaries.size(); i++)
+        totalFrames += summaries[i].frames;
+
+    if(!outputDir.empty()) {
+        std::FILE *summaryFile = std::fopen((outputDir + "/summary.csv").c_str(), "w");
+        if(summaryFile) {
+            std::fprintf(summaryFile, "File;Opened;Frames;Duration[s];HR[bpm];SNR[dB];Measurements;Speed[fps]\n");
+            for(size_t i = 0; i < summaries.size(); i++) {
+                const FileSummary &s = summaries[i];
+                std::fprintf(summaryFile, "%s;%d;%lu;%.2f;%.1f;%.2f;%lu;%.1f\n", s.fileName.data(), s.opened ? 1 : 0, s.frames,
+                             s.duration_s, s.meanHR, s.meanSNR, s.measurements, s.fps);
+            }
+            std::fclose(summaryFile);
+        } else {
+            std::printf("Can not open summary file in %s to write\n", outputDir.data());
+        }
+    }
+
+    std::printf("\n%lu files, %lu frames in %.1f s, %.1f fps with %u jobs\n", (unsigned long)files.size(), totalFrames,
+                elapsed, elapsed > 0.0 ? totalFrames / elapsed : 0.0, jobs);
+    return 0;
+}
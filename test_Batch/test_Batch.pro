@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Headless batch processing of the video files
+#
+#-------------------------------------------------
+
+TARGET = test_Batch
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+CONFIG   -= qt
+
+TEMPLATE = app
+
+SOURCES += main.cpp
+
+include($${PWD}/../lib/opencv.pri)
+include($${PWD}/../lib/exportvpg.pri)
@@ -0,0 +1,285 @@
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "vpg.h"
+#include "threadpool.h"
+
+// Deterministic signal: pulse harmonic, breath harmonic, drift and sensor noise
+class SyntheticSignal
+{
+public:
+    SyntheticSignal(double frequency_Hz, double period_ms) : m_frequency(frequency_Hz), m_period(period_ms), m_generator(1), m_noise(0.0, 0.3), m_count(0) {}
+    double next()
+    {
+        double t = m_count++ * m_period / 1000.0;
+        return 100.0 + std::sin(2.0 * CV_PI * m_frequency * t) + 0.5 * std::sin(2.0 * CV_PI * 0.25 * t) + 0.01 * t + m_noise(m_generator);
+    }
+
+private:
+    double m_frequency;
+    double m_period;
+    std::mt19937 m_generator;
+    std::normal_distribution<double> m_noise;
+    unsigned long m_count;
+};
+
+static void report(const char *name, unsigned long iterations, double elapsed_ms, const char *note = "")
+{
+    std::printf("%-44s %10lu %12.3f us %s\n", name, iterations, 1000.0 * elapsed_ms / std::max(iterations, 1ul), note);
+}
+
+static double measure(const std::function<void()> &workload)
+{
+    int64 ticks = cv::getTickCount();
+    workload();
+    return (cv::getTickCount() - ticks) * 1000.0 / cv::getTickFrequency();
+}
+
+static void benchPulseProcessor(const char *name, double dT_ms, bool fastlock, int seconds)
+{
+    const double period = 33.0;
+    vpg::PulseProcessor proc(dT_ms);
+    proc.setFastLock(fastlock);
+    SyntheticSignal signal(1.3, period);
+    int frames = static_cast<int>(seconds * 1000.0 / period);
+    double update_ms = 0.0, compute_ms = 0.0, frequency = -1.0;
+    unsigned long computations = 0;
+    for(int i = 0; i < frames; i++) {
+        double value = signal.next();
+        update_ms += measure([&]() { proc.update(value, period); });
+        if(i % 15 == 14) {
+            compute_ms += measure([&]() { frequency = proc.computeFrequency(); });
+            computations++;
+        }
+    }
+    char note[64];
+    std::sprintf(note, "(%.1f bpm, true 78.0 bpm)", frequency);
+    report((std::string(name) + " update").c_str(), frames, update_ms);
+    report((std::string(name) + " computeFrequency").c_str(), computations, compute_ms, note);
+}
+
+// Skin colored frames with a noisy face region, green channel of the face pulses at 1.2 Hz
+static std::vector<cv::Mat> makeSyntheticFrames(int count, const cv::Size &size, const cv::Rect &face, double period_ms)
+{
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> noise(-20, 20);
+    std::vector<cv::Mat> frames(count);
+    for(int k = 0; k < count; k++) {
+        int pulse = static_cast<int>(std::floor(2.0 * std::sin(2.0 * CV_PI * 1.2 * k * period_ms / 1000.0) + 0.5));
+        frames[k] = cv::Mat(size, CV_8UC3);
+        for(int j = 0; j < size.height; j++) {
+            unsigned char *ptr = frames[k].ptr(j);
+            for(int i = 0; i < size.width; i++) {
+                bool inside = face.contains(cv::Point(i, j));
+                ptr[3*i] = static_cast<unsigned char>(inside ? 100 + noise(generator) : 30);
+                ptr[3*i+1] = static_cast<unsigned char>(inside ? 130 + pulse + noise(generator) : 30);
+                ptr[3*i+2] = static_cast<unsigned char>(inside ? 190 + noise(generator) : 30);
+            }
+        }
+    }
+    return frames;
+}
+
+static bool checkSampling(const std::vector<cv::Mat> &frames, const cv::Rect &face)
+{
+    // sampled counts should follow the dense ones, only the noise is higher
+    const int targets[] = {0, 20000, 10000, 5000, 2000};
+    double dense = 0.0;
+    bool passed = true;
+    for(size_t k = 0; k < sizeof(targets) / sizeof(targets[0]); k++) {
+        vpg::FaceProcessor proc;
+        proc.setFaceRect(face);
+        proc.setSamplingTarget(targets[k]);
+        double s = 0.0, t = 0.0, mean = 0.0;
+        for(size_t i = 0; i < frames.size(); i++) {
+            proc.enrollImage(frames[i], s, t);
+            mean += s / frames.size();
+        }
+        if(k == 0)
+            dense = mean;
+        bool ok = std::abs(mean - dense) < 0.01 * dense;
+        std::printf("Sampling target %5d: mean count %.3f, dense %.3f - %s\n", targets[k], mean, dense, ok ? "ok" : "FAILED");
+        passed = passed && ok;
+    }
+    return passed;
+}
+
+static bool checkMaskReuse(const std::vector<cv::Mat> &frames, const cv::Rect &face)
+{
+    // face drifts slowly and then jumps, counts with the cached mask should follow the fresh classification
+    vpg::FaceProcessor fresh, cached;
+    cached.setMaskReuse(true, 8);
+    bool passed = true;
+    double s = 0.0, r = 0.0, t = 0.0, error = 0.0;
+    for(size_t i = 0; i < frames.size(); i++) {
+        cv::Rect rect = face + cv::Point(static_cast<int>(i) / 4, 0);
+        if(i == frames.size() / 2)
+            rect = cv::Rect(face.x / 2, face.y / 2, face.width, face.height);
+        fresh.setFaceRect(rect);
+        cached.setFaceRect(rect);
+        fresh.enrollImage(frames[i], s, t);
+        cached.enrollImage(frames[i], r, t);
+        error = std::max(error, std::abs(r - s) / s);
+    }
+    passed = error < 0.01;
+    std::printf("Mask reuse: max relative count difference %.4f - %s\n", error, passed ? "ok" : "FAILED");
+    return passed;
+}
+
+static bool checkFastLock()
+{
+    // clean harmonics, fast lock estimation should be close to the true rate before the window is filled
+    const double period = 33.0, frequencies[] = {1.0, 1.3, 1.8, 2.5};
+    bool passed = true;
+    for(size_t k = 0; k < sizeof(frequencies) / sizeof(frequencies[0]); k++) {
+        vpg::PulseProcessor proc(period);
+        proc.setFastLock(true);
+        for(int i = 0; i < static_cast<int>(3500.0 / period); i++)
+            proc.update(100.0 + std::sin(2.0 * CV_PI * frequencies[k] * i * period / 1000.0), period);
+        double frequency = proc.computeFrequency();
+        bool ok = std::abs(frequency - 60.0 * frequencies[k]) < 3.0;
+        std::printf("Fast lock at 3.5 s: %.1f bpm, true %.1f bpm - %s\n", frequency, 60.0 * frequencies[k], ok ? "ok" : "FAILED");
+        passed = passed && ok;
+    }
+    return passed;
+}
+
+static bool checkSlowCamera()
+{
+    // frame period is estimated above the longest one the windows allow, signal should stay finite and the rate should be measured
+    const double periods[] = {250.0, 350.0};
+    bool passed = true;
+    for(size_t k = 0; k < sizeof(periods) / sizeof(periods[0]); k++) {
+        vpg::PulseProcessor proc(-1.0);
+        for(int i = 0; i < static_cast<int>(60000.0 / periods[k]); i++)
+            proc.update(100.0 + std::sin(2.0 * CV_PI * 1.0 * i * periods[k] / 1000.0), periods[k]);
+        double frequency = proc.computeFrequency();
+        bool ok = std::isfinite(proc.getSignalSampleValue()) && std::abs(frequency - 60.0) < 3.0;
+        std::printf("Frame period %.0f ms: %.1f bpm, true 60.0 bpm, estimated period %.0f ms - %s\n", periods[k], frequency, proc.getFramePeriod(), ok ? "ok" : "FAILED");
+        passed = passed && ok;
+    }
+    return passed;
+}
+
+static void benchFaceProcessor(const char *name, const std::vector<cv::Mat> &frames, const std::string &cascade, const cv::Rect &face,
+                               int samplingTarget, bool maskReuse, vpg::ThreadPool *pool, int iterations)
+{
+    vpg::FaceProcessor proc;
+    if(face.area() > 0)
+        proc.setFaceRect(face); // detection is skipped, so only the ROI stage is measured
+    else
+        proc.loadClassifier(cascade);
+    proc.setSamplingTarget(samplingTarget);
+    proc.setMaskReuse(maskReuse);
+    proc.setThreadPool(pool);
+    double s = 0.0, t = 0.0, mean = 0.0;
+    unsigned long count = 0;
+    double elapsed = measure([&]() {
+        for(int k = 0; k < iterations; k++)
+            for(size_t i = 0; i < frames.size(); i++) {
+                proc.enrollImage(frames[i], s, t);
+                mean += s;
+                count++;
+            }
+    });
+    char note[64];
+    std::sprintf(note, "(mean count %.3f)", mean / std::max(count, 1ul));
+    report(name, count, elapsed, note);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = 600;
+    std::string videoFileName;
+    std::string cascadeFileName = std::string(OPENCV_DATA_DIR) + std::string("/haarcascades/haarcascade_frontalface_alt.xml");
+    int frameHeight = 1080;
+    int maxFrames = 100;
+    int iterations = 3;
+
+    while( (--argc > 0) && ((*++argv)[0] == '-') ) {
+        char option = *++argv[0];
+        switch (option) {
+            case 't':
+                seconds = std::max(1, std::atoi(++(*argv)));
+                break;
+            case 'i':
+                videoFileName = ++(*argv);
+                break;
+            case 'c':
+                cascadeFileName = ++(*argv);
+                break;
+            case 's':
+                frameHeight = std::max(120, std::atoi(++(*argv)));
+                break;
+            case 'n':
+                maxFrames = std::max(1, std::atoi(++(*argv)));
+                break;
+            case 'r':
+                iterations = std::max(1, std::atoi(++(*argv)));
+                break;
+            case 'h':
+                std::printf("test_Bench\n"
+                            "Options:\n"
+                            " -t[int] - duration of the synthetic signal in seconds (default 600)\n"
+                            " -i[filename] - video with a face for the face stage benchmark with detection (ROI stage is always measured on the synthetic frames)\n"
+                            " -c[filename] - cascade classifier file\n"
+                            " -s[int] - frames are resized to this height (default 1080)\n"
+                            " -n[int] - number of frames loaded from the video (default 100)\n"
+                            " -r[int] - number of passes over the loaded frames (default 3)\n"
+                            " -h - this help ;)\n");
+                return 0;
+        }
+    }
+
+    bool passed = checkFastLock();
+    passed = checkSlowCamera() && passed;
+    cv::Rect syntheticFace(720, 240, 480, 600);
+    std::vector<cv::Mat> syntheticFrames = makeSyntheticFrames(30, cv::Size(1920, 1080), syntheticFace, 33.0);
+    passed = checkSampling(syntheticFrames, syntheticFace) && passed;
+    passed = checkMaskReuse(syntheticFrames, syntheticFace) && passed;
+
+    std::printf("%-44s %10s %15s\n", "workload", "calls", "time per call");
+    benchPulseProcessor("PulseProcessor", 33.0, false, seconds);
+    benchPulseProcessor("PulseProcessor auto period", -1.0, false, seconds);
+    benchPulseProcessor("PulseProcessor fast lock", 33.0, true, 10);
+
+    // ROI stage on the synthetic frames, it also keeps the ROI loops in the profile guided optimization training run
+    vpg::ThreadPool pool;
+    int syntheticIterations = std::max(1, seconds / 60);
+    benchFaceProcessor("FaceProcessor synthetic ROI dense", syntheticFrames, cascadeFileName, syntheticFace, 0, false, 0, syntheticIterations);
+    benchFaceProcessor("FaceProcessor synthetic ROI dense, pool", syntheticFrames, cascadeFileName, syntheticFace, 0, false, &pool, syntheticIterations);
+    benchFaceProcessor("FaceProcessor synthetic ROI sampled 10000", syntheticFrames, cascadeFileName, syntheticFace, 10000, false, 0, syntheticIterations);
+    benchFaceProcessor("FaceProcessor synthetic ROI dense, mask reuse", syntheticFrames, cascadeFileName, syntheticFace, 0, true, 0, syntheticIterations);
+    benchFaceProcessor("FaceProcessor synthetic ROI sampled, mask reuse", syntheticFrames, cascadeFileName, syntheticFace, 10000, true, 0, syntheticIterations);
+
+    if(!videoFileName.empty()) {
+        cv::VideoCapture capture;
+        if(!capture.open(videoFileName)) {
+            std::printf("Can not open %s\n", videoFileName.c_str());
+            return -1;
+        }
+        std::vector<cv::Mat> frames;
+        cv::Mat frame;
+        while(frames.size() < static_cast<size_t>(maxFrames) && capture.read(frame)) {
+            cv::Mat resized;
+            cv::resize(frame, resized, cv::Size(frame.cols * frameHeight / frame.rows, frameHeight), 0.0, 0.0, cv::INTER_LINEAR);
+            frames.push_back(resized);
+        }
+        vpg::FaceProcessor probe(cascadeFileName);
+        if(probe.empty()) {
+            std::printf("Can not load %s\n", cascadeFileName.c_str());
+            return -1;
+        }
+        cv::Rect detect(0, 0, 0, 0);
+        benchFaceProcessor("FaceProcessor dense", frames, cascadeFileName, detect, 0, false, 0, iterations);
+        benchFaceProcessor("FaceProcessor dense, pool", frames, cascadeFileName, detect, 0, false, &pool, iterations);
+        benchFaceProcessor("FaceProcessor sampled 10000", frames, cascadeFileName, detect, 10000, false, 0, iterations);
+        benchFaceProcessor("FaceProcessor dense, mask reuse", frames, cascadeFileName, detect, 0, true, 0, iterations);
+        benchFaceProcessor("FaceProcessor sampled, mask reuse", frames, cascadeFileName, detect, 10000, true, 0, iterations);
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Synthetic benchmark of the library hot paths,
+# also serves as training workload for CONFIG+=pgo_generate
+#
+#-------------------------------------------------
+
+TARGET = test_Bench
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+CONFIG   -= qt
+
+TEMPLATE = app
+
+SOURCES += main.cpp
+
+include($${PWD}/../lib/opencv.pri)
+include($${PWD}/../lib/exportvpg.pri)
+include($${PWD}/../lib/optimization.pri)
@@ -6,6 +6,7 @@
 
 #include <opencv2/opencv.hpp>
 #include "vpg.h"
+#include "signalrecorder.h"
 
 template<typename T>
 std::string num2str(T num, unsigned char precision=0)
@@ -30,6 +31,7 @@ int main(int argc, char *argv[])
     int deviceID = 0;
     char *outputHRfilename = 0;
     char *outputVPGfilename = 0;
+    char *outputRecordfilename = 0;
     char *outputVideofilename = 0;
     char *inputVideofilename = 0;
     while((--argc > 0) && ((*++argv)[0] == '-')) {
@@ -53,6 +55,16 @@ int main(int argc, char *argv[])
             case 'w':
                 outputVideofilename = ++argv[0];
                 break;
+            case 'b':
+                outputRecordfilename = ++argv[0];
+                break;
+            case 'c':
+                if(argc > 1 && vpg::SignalRecorder::convertToCSV(++argv[0], *(argv + 1))) {
+                    std::cout << "Converted to " << *(argv + 1) << std::endl;
+                    return 0;
+                }
+                std::cout << "Could not convert binary record. Abort..." << std::endl;
+                return -1;
             case 'h':
                 std::cout << APP_NAME << " v" << APP_VERSION << " help" << std::endl << std::endl
                           << " -v[int] - video device enumerator (default " << deviceID << ")" << std::endl
@@ -61,6 +73,8 @@ int main(int argc, char *argv[])
                           << " -o[str] - output file with the HR vs time" << std::endl
                           << " -s[str] - output file with the VPG counts vs frame number" << std::endl
                           << " -w[str] - output video file name" << std::endl
+                          << " -b[str] - output binary record file (see vpg::SignalRecorder)" << std::endl
+                          << " -c[str] [str] - convert binary record file into text file and exit" << std::endl
                           << " -h - help :)" << std::endl << std::endl
                           << APP_DESIGNER << std::endl;
                 return 0;
@@ -91,6 +105,16 @@ int main(int argc, char *argv[])
         }
     }
 
+    // Open binary record if it is needed
+    vpg::SignalRecorder recorder;
+    if(outputRecordfilename != 0) {
+        if(!recorder.open(outputRecordfilename)) {
+            std::cout << "Could not open file " << outputRecordfilename
+                      << " for writing. Abort...";
+            return -1;
+        }
+    }
+
     cv::VideoCapture capture;
     if(inputVideofilename) {
         if(capture.open(inputVideofilename) == false) {
@@ -110,25 +134,26 @@ int main(int argc, char *argv[])
     vpg::FaceProcessor faceproc(std::string("haarcascades/haarcascade_frontalface_alt2.xml"));
     #endif
 
-    std::cout << "Measure frame period... " << std::endl;
-    double framePeriod = faceproc.measureFramePeriod(&capture); // milliseconds
-    std::cout << framePeriod << " ms" << std::endl;
-    vpg::PulseProcessor pulseproc(framePeriod);
+    vpg::PulseProcessor pulseproc(-1.0); // frame period will be estimated online from the first frames
+    double framePeriod = 1000.0 / capture.get(cv::CAP_PROP_FPS); // milliseconds, it is used only for the video writer
+    if(!(framePeriod > 0.0 && framePeriod < 1000.0))
+        framePeriod = 33.0;
 
     cv::VideoWriter videowriter;
     if(outputVideofilename)
-        if(videowriter.open(outputVideofilename, CV_FOURCC('M','P','4','2'), 1000.0/framePeriod, cv::Size(capture.get(CV_CAP_PROP_FRAME_WIDTH), capture.get(CV_CAP_PROP_FRAME_HEIGHT))) == false)
+        if(videowriter.open(outputVideofilename, cv::VideoWriter::fourcc('M','P','4','2'), 1000.0/framePeriod, cv::Size(capture.get(cv::CAP_PROP_FRAME_WIDTH), capture.get(cv::CAP_PROP_FRAME_HEIGHT))) == false)
             std::cout << "Warning! Output videofile can not be opened!" << std::endl;
 
     cv::Mat frame;
     double s = 0.0, t = 0.0, timeout = measInt_ms;
-    int length = pulseproc.getLength();
+    int length = 0;
     const double *vS = pulseproc.getSignal();
     cv::Point p1(0,0), p2(0,0);
     cv::Rect faceRect;
     unsigned int frequency = 80;
     double snr = 0.0;
     unsigned long framecounter = 0;
+    double recordtime = 0.0;
 
     std::time_t _timet = std::time(0);
     struct std::tm * now = localtime( &_timet );
@@ -168,6 +193,8 @@ int main(int argc, char *argv[])
 
             if(faceRect.area() > 0) {
 
+                length = pulseproc.getLength();
+
                 float shiftX = frame.cols * 0.1f;
                 float stepX = static_cast<float>(frame.cols - 2*shiftX) / length;
                 float stepY = 0.025f * frame.rows;
@@ -176,25 +203,25 @@ int main(int argc, char *argv[])
                 for(int i = 0; i < length - 1; i++) {
                     p1 = cv::Point2f(shiftX + stepX * i, shiftY + stepY * vS[i]);
                     p2 = cv::Point2f(shiftX + stepX * (i + 1), shiftY + stepY * vS[i + 1]);
-                    cv::line(frame, p1, p2, cv::Scalar(0,255,0), 1, CV_AA);
+                    cv::line(frame, p1, p2, cv::Scalar(0,255,0), 1, cv::LINE_AA);
                 }
 
-                cv::rectangle(frame,faceproc.getFaceRect(),cv::Scalar(0,0,0), 1, CV_AA);
-                cv::rectangle(frame,faceproc.getFaceRect()-cv::Point(1,1),cv::Scalar(255,255,255), 1, CV_AA);
+                cv::rectangle(frame,faceproc.getFaceRect(),cv::Scalar(0,0,0), 1, cv::LINE_AA);
+                cv::rectangle(frame,faceproc.getFaceRect()-cv::Point(1,1),cv::Scalar(255,255,255), 1, cv::LINE_AA);
 
-                cv::putText(frame, "HR [bpm]:", cv::Point(11, 31), CV_FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0,0,0), 1, CV_AA);
-                cv::putText(frame, "HR [bpm]:", cv::Point(10, 30), CV_FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255,255,255), 1, CV_AA);
+                cv::putText(frame, "HR [bpm]:", cv::Point(11, 31), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0,0,0), 1, cv::LINE_AA);
+                cv::putText(frame, "HR [bpm]:", cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255,255,255), 1, cv::LINE_AA);
 
                 std::string _freqstr = num2str(frequency);
-                cv::putText(frame, _freqstr, cv::Point(101, 35), CV_FONT_HERSHEY_SIMPLEX, 1.2, cv::Scalar(0,0,0), 1, CV_AA);
-                cv::putText(frame, _freqstr, cv::Point(100, 34), CV_FONT_HERSHEY_SIMPLEX, 1.2, ( frequency > 65 && frequency < 85) ? cv::Scalar(0,230,0) : cv::Scalar(0,0,230), 1, CV_AA);
+                cv::putText(frame, _freqstr, cv::Point(101, 35), cv::FONT_HERSHEY_SIMPLEX, 1.2, cv::Scalar(0,0,0), 1, cv::LINE_AA);
+                cv::putText(frame, _freqstr, cv::Point(100, 34), cv::FONT_HERSHEY_SIMPLEX, 1.2, ( frequency > 65 && frequency < 85) ? cv::Scalar(0,230,0) : cv::Scalar(0,0,230), 1, cv::LINE_AA);
 
                 std::string _snrstr = "snr: " + num2str(snr,2) + " dB";
-                cv::putText(frame, _snrstr, cv::Point(11, 61), CV_FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0,0,0), 1, CV_AA);
-                cv::putText(frame, _snrstr, cv::Point(10, 60), CV_FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255,255,255), 1, CV_AA);
+                cv::putText(frame, _snrstr, cv::Point(11, 61), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0,0,0), 1, cv::LINE_AA);
+                cv::putText(frame, _snrstr, cv::Point(10, 60), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255,255,255), 1, cv::LINE_AA);
             }
-            cv::putText(frame, num2str(t,1) + " ms, press ESC to exit or 's' to get DirectShow settings", cv::Point(11, frame.rows - 10), CV_FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0,0,0), 1, CV_AA);
-            cv::putText(frame, num2str(t,1) + " ms, press ESC to exit or 's' to get DirectShow settings", cv::Point(10, frame.rows - 11), CV_FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255,255,255), 1, CV_AA);
+            cv::putText(frame, num2str(t,1) + " ms, press ESC to exit or 's' to get DirectShow settings", cv::Point(11, frame.rows - 10), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0,0,0), 1, cv::LINE_AA);
+            cv::putText(frame, num2str(t,1) + " ms, press ESC to exit or 's' to get DirectShow settings", cv::Point(10, frame.rows - 11), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255,255,255), 1, cv::LINE_AA);
 
             cv::imshow("vpglib test", frame);
         }
@@ -216,7 +243,12 @@ int main(int argc, char *argv[])
                    << std::setprecision(3) << ";\t" << pulseproc.getSignalSampleValue()
                    << ";\t" << frequency
                    << std::setprecision(2) << ";\t" << snr
-                   << std::endl;
+                   << '\n';
+        }
+
+        if(recorder.isOpened()) {
+            recordtime += t;
+            recorder.write(framecounter, recordtime, s, pulseproc.getSignalSampleValue(), frequency, snr, faceRect);
         }
 
         int c = cv::waitKey(1); // process frame as often as it is possible
@@ -224,7 +256,7 @@ int main(int argc, char *argv[])
             break;
         else switch(c) {
             case 's':
-                capture.set(CV_CAP_PROP_SETTINGS,0.0);
+                capture.set(cv::CAP_PROP_SETTINGS,0.0);
                 break;
         }
 
@@ -242,5 +274,11 @@ int main(int argc, char *argv[])
     if(ovpgfs.is_open())
         ovpgfs.close();
 
+    if(recorder.isOpened()) {
+        recorder.close();
+        if(recorder.getDropped() > 0)
+            std::cout << recorder.getDropped() << " records were dropped from " << outputRecordfilename << std::endl;
+    }
+
     return 0;
 }
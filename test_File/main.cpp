@@ -48,9 +48,9 @@ int main(int argc, char *argv[])
     vpg::FaceProcessor faceproc(std::string(OPENCV_DATA_DIR) +
                                 std::string("/haarcascades/haarcascade_frontalface_alt.xml"));
 
-    unsigned long totalFrames = (unsigned long)capture.get(CV_CAP_PROP_FRAME_COUNT);
-    double framePeriod = 1000.0 / capture.get(CV_CAP_PROP_FPS); // milliseconds
-    vpg::PulseProcessor pulseproc(7000.0, framePeriod, vpg::PulseProcessor::HeartRate);
+    unsigned long totalFrames = (unsigned long)capture.get(cv::CAP_PROP_FRAME_COUNT);
+    double framePeriod = 1000.0 / capture.get(cv::CAP_PROP_FPS); // milliseconds
+    vpg::PulseProcessor pulseproc(framePeriod, vpg::PulseProcessor::HeartRate); // 7000 ms record
 
     uint k = 1;
     double s = 0.0, t = 0.0;
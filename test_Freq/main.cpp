@@ -9,7 +9,7 @@ int main(int argc, char *argv[])
 
     double Tovms = 10000.0;
     double dTms = 33.0;
-    vpg::PulseProcessor *proc = new vpg::PulseProcessor(7000.0, dTms, vpg::PulseProcessor::HeartRate);
+    vpg::PulseProcessor *proc = new vpg::PulseProcessor(dTms, vpg::PulseProcessor::HeartRate); // 7000 ms record
 
     double sV = 0.0;
     double f0 = 0.8;